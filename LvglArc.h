@@ -0,0 +1,21 @@
+#pragma once
+
+#include "esphome.h"
+#include "lvgl.h"
+#include "LvglValueWidget.h"
+
+struct LvglArcTraits
+{
+  static lv_obj_t *create(lv_obj_t *parent, int32_t min, int32_t max)
+  {
+    lv_obj_t *obj = lv_arc_create(parent);
+    lv_arc_set_range(obj, min, max);
+    return obj;
+  }
+  static int32_t get(lv_obj_t *obj) { return lv_arc_get_value(obj); }
+  static void set(lv_obj_t *obj, int32_t value) { lv_arc_set_value(obj, value); }
+};
+
+#ifdef USE_NUMBER // with a number: component in the yaml
+using LvglArc = LvglNumberWidget<LvglArcTraits>;
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "esphome.h"
+#include "lvgl.h"
+#include "LvglValueWidget.h"
+
+struct LvglBarTraits
+{
+  static lv_obj_t *create(lv_obj_t *parent, int32_t min, int32_t max)
+  {
+    lv_obj_t *obj = lv_bar_create(parent);
+    lv_bar_set_range(obj, min, max);
+    return obj;
+  }
+  static int32_t get(lv_obj_t *obj) { return lv_bar_get_value(obj); }
+  // Without animation, an animated bar would be redrawn every frame until it arrives
+  static void set(lv_obj_t *obj, int32_t value) { lv_bar_set_value(obj, value, LV_ANIM_OFF); }
+};
+
+#ifdef USE_SENSOR // with a sensor: component in the yaml
+using LvglBar = LvglSensorWidget<LvglBarTraits>;
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "esphome.h"
+#include "LvglComponent.h"
+
+#ifdef USE_SENSOR // Sensor only exists when the yaml has a sensor: component
+// Boot timing of the display, published once after the first lvgl frame has been flushed
+class LvglBootSensor : public Component
+{
+public:
+  Sensor *first_flush_sensor = new Sensor(); // power on to first frame on the panel, time to interactive
+  Sensor *splash_sensor = new Sensor();      // power on to splash visible
+  Sensor *lvgl_setup_sensor = new Sensor();  // LvglComponent::setup duration
+  Sensor *widgets_sensor = new Sensor();     // setup of the remaining components, mostly widget creation
+
+  void loop() override
+  {
+    if (this->published_ || boot_phase_ms[BOOT_FIRST_FLUSH] == 0)
+      return;
+    this->published_ = true;
+
+    // The render task marks the first flush, the phases before it are only written by this loop
+    uint32_t first_flush = boot_phase_ms[BOOT_FIRST_FLUSH];
+    uint32_t splash = boot_phase_ms[BOOT_SPLASH];
+    first_flush_sensor->publish_state(first_flush);
+    splash_sensor->publish_state(splash);
+    lvgl_setup_sensor->publish_state(boot_phase_ms[BOOT_STYLES] - boot_phase_ms[BOOT_START]);
+    widgets_sensor->publish_state(boot_phase_ms[BOOT_WIDGETS] - boot_phase_ms[BOOT_STYLES]);
+
+    ESP_LOGI("lvgl.boot", "First frame %u ms after power on, splash at %u ms", (unsigned)first_flush, (unsigned)splash);
+  }
+  float get_setup_priority() const override { return esphome::setup_priority::LATE; }
+
+private:
+  bool published_ = false;
+};
+#endif
@@ -1,23 +1,219 @@
 #pragma once
 
+#include <atomic>
+#include <vector>
 #include "esphome.h"
 #include "lvgl.h"
 #include "lv_demo.h"
+#ifdef USE_TFT_SIMULATOR
+#include "tft-simulator.h"
+#else
 #include "TFT_eSPI.h"
+#endif
 #include "bootlogo.h"
+#include "tft-splash.h"
+#include "LvglPublisher.h"
+#include "LvglStyles.h"
+#include "LvglMemPool.h"
+#include "LvglGlyphCache.h"
+#include "LvglImageCache.h"
+#include "LvglSnapshot.h"
+#include "LvglDrawBuffer.h"
+#include "LvglShadow.h"
+#include "LvglPerf.h"
+#include "LvglTask.h"
 
-const size_t buf_pix_count = LV_HOR_RES_MAX * LV_VER_RES_MAX / 5;
+#ifndef LVGL_WINDOW_COST_PX
+#define LVGL_WINDOW_COST_PX 128 /* overhead of an extra flush window, in pixels that could be sent instead */
+#endif
 
 static lv_disp_draw_buf_t disp_buf;
-static lv_color_t buf[buf_pix_count];
-lv_style_t switch_style;
+static LvglDrawBuffers draw_buffers; /* allocated in LvglComponent::setup, see LvglDrawBuffer.h */
+#ifdef LVGL_SHADOW_FB
+static ShadowFramebuffer shadow_fb; /* what the panel shows, see LvglShadow.h */
+#endif
+#ifdef USE_DMA_TO_TFT
+static lv_disp_drv_t *volatile dma_flush_pending = NULL; /* flush that is waiting for its DMA transfer */
+static bool dma_flush_last = false;                       /* pending flush is the last area of the refresh */
+#endif
+static bool tft_writing = false; /* one SPI transaction spans all areas of a refresh */
+LvglStatePublisher state_publisher; /* widget states are published once per frame */
+
+#ifdef LVGL_RENDER_TASK
+/* A call into lvgl from outside the render task, applied before the next lv_timer_handler */
+struct lvgl_cmd_t
+{
+  void (*apply)(void *target, int32_t value);
+  void *target;
+  int32_t value;
+};
+/* A widget change reported by lvgl, publish(source, value) runs in the main loop */
+struct lvgl_event_t
+{
+  void (*publish)(void *source, int32_t value);
+  void *source;
+  int32_t value;
+};
+static LvglThread lvgl_task;
+static LvglQueue<lvgl_cmd_t, LVGL_QUEUE_LEN> lvgl_commands;
+static LvglQueue<lvgl_event_t, LVGL_QUEUE_LEN> lvgl_events;
+static LvglQueue<lv_mem_monitor_t, 2> lvgl_mem_snapshots; /* answers to lvgl_mem_requested */
+static std::atomic<bool> lvgl_mem_requested{false};
+static LvglQueue<lvgl_perf_t, 2> lvgl_perf_snapshots; /* answers to lvgl_perf_requested */
+static std::atomic<bool> lvgl_perf_requested{false};
+static std::atomic<uint32_t> lvgl_queue_drops{0}; /* commands and events lost to a full queue */
+static lv_mem_monitor_t lvgl_mem_last;          /* main loop copy of the last snapshot */
+#endif
+
+/* Run apply(target, value) where lvgl may be touched: right away, or queued for the render task */
+static void lvgl_call(void (*apply)(void *target, int32_t value), void *target, int32_t value)
+{
+#ifdef LVGL_RENDER_TASK
+  if (lvgl_task.running() && !lvgl_task.is_current())
+  {
+    if (lvgl_commands.push({apply, target, value}))
+      lvgl_task.wake();
+    else
+    {
+      lvgl_queue_drops++;
+      ESP_LOGW("lvgl", "Command queue full, call dropped");
+    }
+    return;
+  }
+#endif
+  apply(target, value);
+}
+
+/* Run publish(source, value) for a change reported by an lvgl event in the main loop, where entities are published */
+static void lvgl_report(void (*publish)(void *source, int32_t value), void *source, int32_t value)
+{
+#ifdef LVGL_RENDER_TASK
+  if (lvgl_task.is_current())
+  {
+    if (!lvgl_events.push({publish, source, value}))
+      lvgl_queue_drops++;
+    return;
+  }
+#endif
+  publish(source, value);
+}
+
+static void lvgl_queue_state(void *sw, int32_t state) { state_publisher.queue((Switch *)sw, state); }
+
+/* Hand a state change from an lvgl event to the publisher */
+static void lvgl_report_state(Switch *sw, bool state) { lvgl_report(lvgl_queue_state, sw, state); }
+
+/* Flush path counters, cumulative since boot */
+struct flush_stats_t
+{
+  uint32_t flushes; /* gui_flush_cb calls */
+  uint32_t windows; /* setWindow calls */
+  uint64_t pixels;  /* pixels pushed to the TFT */
+  uint32_t transactions; /* SPI write transactions */
+  uint32_t joined;  /* invalidated areas merged into another one */
+  uint64_t skipped; /* unchanged pixels the shadow framebuffer kept from being sent */
+};
+static flush_stats_t flush_stats;
+
+/* Statistics of the widget families, logged with the load report. Added to and called in the lvgl thread. */
+static std::vector<void (*)()> lvgl_stats_reports;
+
+/* lvgl heap statistics, every heap reading goes through here */
+#ifdef LVGL_USE_MEM_POOL
+static void lvgl_mem_read(lv_mem_monitor_t *mon) { lv_mem_pool_monitor(mon); }
+#else
+static void lvgl_mem_read(lv_mem_monitor_t *mon) { lv_mem_monitor(mon); }
+#endif
+
+static void lvgl_mem_monitor(lv_mem_monitor_t *mon)
+{
+#ifdef LVGL_RENDER_TASK
+  if (lvgl_task.running() && !lvgl_task.is_current())
+  {
+    /* Only the render task may walk the heap, it answers the request with a snapshot after its next pass */
+    while (lvgl_mem_snapshots.pop(&lvgl_mem_last))
+      ;
+    lvgl_mem_requested = true;
+    *mon = lvgl_mem_last;
+    return;
+  }
+#endif
+  lvgl_mem_read(mon);
+}
+
+/* Take the performance histograms collected since the last call and start new ones.
+   With a render task, which feeds them, it hands them over after its next pass: the answer is one call late. */
+static void lvgl_perf_take(lvgl_perf_t *perf)
+{
+#ifdef LVGL_RENDER_TASK
+  if (lvgl_task.running() && !lvgl_task.is_current())
+  {
+    bool answered = false;
+    while (lvgl_perf_snapshots.pop(perf))
+      answered = true;
+    if (!answered)
+      *perf = lvgl_perf_t();
+    lvgl_perf_requested = true;
+    return;
+  }
+#endif
+  *perf = lvgl_perf;
+  lvgl_perf = lvgl_perf_t();
+}
+
+static uint32_t lvgl_mem_used()
+{
+  lv_mem_monitor_t mon;
+  lvgl_mem_monitor(&mon);
+  return mon.total_size - mon.free_size;
+}
+
+#ifndef LVGL_SPLASH_MIN_MS
+#define LVGL_SPLASH_MIN_MS 250 /* [ms] the splash stays up at least, overlapping lvgl and widget setup */
+#endif
+
+/* Boot phases, each one is timestamped when it has completed */
+enum boot_phase_t
+{
+  BOOT_START,       /* LvglComponent::setup entered */
+  BOOT_TFT,         /* tft.begin and display configuration */
+  BOOT_SPLASH,      /* splash drawn */
+  BOOT_TOUCH,       /* touch calibration */
+  BOOT_LV_INIT,     /* lv_init */
+  BOOT_DRIVERS,     /* display and input drivers registered */
+  BOOT_STYLES,      /* styles initialized, end of LvglComponent::setup */
+  BOOT_WIDGETS,     /* all components set up, first loop */
+  BOOT_FIRST_FLUSH, /* first lvgl flush sent to the TFT */
+  BOOT_PHASES
+};
+static const char *const boot_phase_names[BOOT_PHASES] = {"start",   "tft",    "splash",  "touch",      "lv_init",
+                                                          "drivers", "styles", "widgets", "first_flush"};
+/* millis() since power on, 0 = not reached yet. The first flush is marked by the render task when there is one. */
+static std::atomic<uint32_t> boot_phase_ms[BOOT_PHASES];
+
+static void IRAM_ATTR boot_mark(boot_phase_t phase)
+{
+  if (boot_phase_ms[phase] != 0)
+    return;
+
+  uint32_t now = millis();
+  boot_phase_ms[phase] = now ? now : 1;
+  ESP_LOGD("lvgl.boot", "%-11s at %5u ms (+%u ms)", boot_phase_names[phase], (unsigned)now,
+           phase > BOOT_START ? (unsigned)(now - boot_phase_ms[phase - 1]) : 0u);
+}
 
 /* LVGL callbacks - Needs to be accessible from C library */
 void IRAM_ATTR my_touchpad_read(lv_indev_drv_t *indev_driver, lv_indev_data_t *data);
 void IRAM_ATTR gui_flush_cb(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_p);
+void IRAM_ATTR gui_flush_wait_cb(lv_disp_drv_t *disp);
+void IRAM_ATTR gui_refr_timer_cb(lv_timer_t *timer);
+bool IRAM_ATTR gui_flush_poll(bool wait);
+void IRAM_ATTR gui_flush_end_write();
 
 TFT_eSPI tft;
 
+#include "LvglTouch.h"
+
 class LvglComponent : public Component
 {
 public:
@@ -25,14 +221,20 @@ public:
   {
     // This will be called once to set up the component
     // think of it as the setup() call in Arduino
-    tft_setup();
+    boot_mark(BOOT_START);
+    if (!tft_setup())
+    {
+      this->mark_failed();
+      return;
+    }
     lv_init();
+    boot_mark(BOOT_LV_INIT);
 
 #if USE_LV_LOG != 0
     lv_log_register_print_cb(my_print); /* register print function for debugging */
 #endif
 
-    lv_disp_draw_buf_init(&disp_buf, buf, NULL, buf_pix_count);
+    draw_buffers.init(&disp_buf);
 
     /*Initialize the display*/
     static lv_disp_drv_t disp_drv;
@@ -40,110 +242,515 @@ public:
     disp_drv.hor_res = TFT_WIDTH;
     disp_drv.ver_res = TFT_HEIGHT;
     disp_drv.flush_cb = gui_flush_cb;
+    disp_drv.wait_cb = gui_flush_wait_cb;
     disp_drv.draw_buf = &disp_buf;
-    lv_disp_drv_register(&disp_drv);
+    lv_disp_t *disp = lv_disp_drv_register(&disp_drv);
+    lv_timer_set_cb(disp->refr_timer, gui_refr_timer_cb); /* join areas before each refresh */
+#ifdef LVGL_IMG_CACHE
+    image_cache.init();
+#endif
+
+    /*Initialize the touch sampler, the TFT_eSPI touch controller unless the yaml set another one*/
+    if (this->touch_.get_source() == NULL)
+      this->touch_.set_source(&this->xpt2046_);
+    this->touch_.get_source()->begin();
 
     /*Initialize the input device driver*/
     static lv_indev_drv_t indev_drv;
     lv_indev_drv_init(&indev_drv);
     indev_drv.type = LV_INDEV_TYPE_POINTER;
     indev_drv.read_cb = my_touchpad_read;
+    indev_drv.user_data = &this->touch_;
     lv_indev_drv_register(&indev_drv);
+    boot_mark(BOOT_DRIVERS);
 
-    // Make unchecked checkboxes darker grey
-    lv_style_init(&switch_style);
-    lv_style_set_bg_color(&switch_style, lv_palette_main(LV_PALETTE_GREY));
+    // Built-in styles are constant, see LvglStyles.h
+    boot_mark(BOOT_STYLES);
+    this->setup_mem_used_ = lvgl_mem_used();
 
     // lv_demo_widgets();
     // lv_demo_music();
 
-    this->high_freq_.start(); // avoid 16 ms delay
+    this->high_freq_.start(); // avoid 16 ms delay until the first frame is drawn
   }
   void IRAM_ATTR loop() override
   {
     // This will be called every "update_interval" milliseconds.
-    lv_timer_handler(); // called by dispatch_loop
-    // this->high_freq_.stop();  // decrease the counter for check
-    // if (high_freq_num_requests == 1)
-    //   delay(5);
-    // this->high_freq_.start();  // increase the counter for main loop
+    if (boot_phase_ms[BOOT_WIDGETS] == 0)
+    {
+      boot_mark(BOOT_WIDGETS);
+      ESP_LOGD("lvgl", "Widget setup used %d bytes of lvgl memory", (int)(lvgl_mem_used() - this->setup_mem_used_));
+#ifdef LVGL_RENDER_TASK
+      start_task();
+#endif
+    }
+#ifdef LVGL_RENDER_TASK
+    if (lvgl_task.running())
+    {
+      // A touch controller on a bus of the main loop is read here, the render task only gets the point
+      if (this->touch_.get_source()->main_loop_bus() && this->touch_.update(millis()))
+        lvgl_task.wake();
+      publish_events();
+      report_publishes(millis());
+      return;
+    }
+#endif
+
+#ifdef USE_TFT_SIMULATOR
+    sim_tick(); // advance the virtual lvgl clock
+#endif
+    uint32_t wait = step(millis());
+    state_publisher.flush(millis());
+    report_publishes(millis());
+
+    // Only keep the main loop spinning while lvgl is drawing, animating or being touched
+    if (wait == 0 || state_publisher.has_pending() || boot_phase_ms[BOOT_FIRST_FLUSH] == 0)
+      this->high_freq_.start();
+    else
+      this->high_freq_.stop();
   }
   float get_setup_priority() const override { return esphome::setup_priority::DATA; }
 
+  // Use another touch controller, e.g. new FT6X36TouchSource(id(i2c_bus)) for capacitive panels on the i2c: bus
+  void set_touch_source(TouchSource *source) { this->touch_.set_source(source); }
+  // Sample period while touched, and while released when the controller has no IRQ line
+  void set_touch_periods(uint16_t touched_ms, uint16_t idle_ms) { this->touch_.set_periods(touched_ms, idle_ms); }
+  TouchSampler *get_touch_sampler() { return &this->touch_; }
+
+  // Minimum time between two state publishes of the same widget
+  void set_publish_min_interval(uint16_t ms) { state_publisher.set_min_interval(ms); }
+
+  // Rows lvgl renders per flush (0 = default), or a full frame buffer in PSRAM instead of stripes in internal RAM.
+  // With two buffers (USE_DMA_TO_TFT) the stripe height adapts to the render and flush times unless adaptive is false.
+  void set_draw_buffer(uint16_t lines, bool psram = false, bool adaptive = true)
+  {
+    draw_buffers.configure(lines, psram, adaptive);
+  }
+
+#ifdef LVGL_IMG_CACHE
+  // Decoded images, e.g. get_image_cache()->pin(&icon) for icons that are always on screen
+  ImageCache *get_image_cache() { return &image_cache; }
+#endif
+
+  // Share of the loop time spent in lv_timer_handler during the last report period, in percent
+  float get_loop_load() { return this->loop_load_; }
+
 private:
-  /// High Frequency loop() requester used during sampling phase.
+  TouchSampler touch_;
+  XPT2046TouchSource xpt2046_;
+
+  /// High Frequency loop() requester, only active while lvgl has work pending.
   HighFrequencyLoopRequester high_freq_;
+  uint32_t next_run_ = 0;      // millis() when the next lvgl timer is due
+  uint32_t busy_us_ = 0;       // time spent in lv_timer_handler since the last report
+  uint32_t report_start_ = 0;  // millis() of the last report
+  uint32_t publish_report_start_ = 0;
+  float loop_load_ = 0;
+  uint32_t setup_mem_used_ = 0; // lvgl memory in use before the widgets were created
+
+  /* One pass of lvgl, from the main loop or the render task.
+     Returns the ms until the next pass is due, 0 while lvgl has work pending. */
+  uint32_t step(uint32_t now)
+  {
+    gui_flush_poll(false); // hand a completed DMA buffer back to lvgl
+    if (!touch_in_main_loop())
+      this->touch_.update(now); // sample the touch controller when due
+
+    // Keep the splash up for its minimum time, the widgets have been created meanwhile
+    uint32_t splash = now - boot_phase_ms[BOOT_SPLASH];
+    if (boot_phase_ms[BOOT_FIRST_FLUSH] == 0 && splash < LVGL_SPLASH_MIN_MS)
+      return LVGL_SPLASH_MIN_MS - splash;
+
+    // Sleep until the next lvgl timer is due, unless there is work pending right now
+    if (!has_work() && (int32_t)(now - this->next_run_) < 0)
+      return LV_MIN(this->next_run_ - now, this->touch_.get_period());
+
+    uint32_t start = micros();
+    uint32_t next = lv_timer_handler(); // called by dispatch_loop
+    uint32_t handler_us = micros() - start;
+    this->busy_us_ += handler_us;
+    lvgl_perf.handler_us.add(handler_us);
+    this->next_run_ = millis() + next;
+
+    report_load(now);
+    return has_work() ? 0 : LV_MIN(next, this->touch_.get_period());
+  }
+
+#ifdef LVGL_RENDER_TASK
+  void start_task()
+  {
+    lvgl_mem_read(&lvgl_mem_last); // first answer of lvgl_mem_monitor
+    this->high_freq_.stop();
+    lvgl_task.start(task_main, this);
+    ESP_LOGI("lvgl", "Render task started on core %d", LVGL_TASK_CORE);
+  }
+
+  static void task_main(void *arg)
+  {
+    LvglComponent *self = (LvglComponent *)arg;
+    for (;;)
+    {
+#ifdef USE_TFT_SIMULATOR
+      sim_tick();
+#endif
+      lvgl_cmd_t cmd;
+      while (lvgl_commands.pop(&cmd))
+        cmd.apply(cmd.target, cmd.value);
+
+      if (lvgl_mem_requested.exchange(false))
+      {
+        lv_mem_monitor_t mon;
+        lvgl_mem_read(&mon);
+        lvgl_mem_snapshots.push(mon);
+      }
+      if (lvgl_perf_requested.exchange(false))
+      {
+        lvgl_perf_snapshots.push(lvgl_perf);
+        lvgl_perf = lvgl_perf_t();
+      }
+
+      lvgl_task.sleep(self->step(millis()));
+    }
+  }
+
+  // Main loop side of the render task, publish the states lvgl has reported
+  void publish_events()
+  {
+    lvgl_event_t event;
+    while (lvgl_events.pop(&event))
+      event.publish(event.source, event.value);
+    state_publisher.flush(millis());
+  }
+#endif
+
+  // The touch source is sampled by loop() instead, the render task only reads the point
+  bool touch_in_main_loop()
+  {
+#ifdef LVGL_RENDER_TASK
+    return lvgl_task.is_current() && this->touch_.get_source()->main_loop_bus();
+#else
+    return false;
+#endif
+  }
 
-  void tft_setup()
+  bool has_work()
+  {
+#ifdef USE_DMA_TO_TFT
+    if (dma_flush_pending != NULL)
+      return true;
+#endif
+    lv_disp_t *disp = lv_disp_get_default();
+    return (disp != NULL && disp->inv_p > 0) || lv_anim_count_running() > 0 || this->touch_.is_pressed();
+  }
+
+  // The publisher belongs to the main loop, with a render task too
+  void report_publishes(uint32_t now)
+  {
+    if (now - this->publish_report_start_ < 10000)
+      return;
+    this->publish_report_start_ = now;
+    ESP_LOGD("lvgl", "state publishes: %u queued, %u sent, %u suppressed", (unsigned)state_publisher.stats.queued,
+             (unsigned)state_publisher.stats.sent, (unsigned)state_publisher.stats.suppressed);
+  }
+
+  void report_load(uint32_t now)
+  {
+    uint32_t elapsed = now - this->report_start_;
+    if (elapsed < 10000)
+      return;
+
+    this->loop_load_ = this->busy_us_ / (elapsed * 10.0f);
+    ESP_LOGD("lvgl", "lv_timer_handler used %.1f%% of the loop, high frequency loop %s", this->loop_load_,
+             HighFrequencyLoopRequester::is_high_frequency() ? "on" : "off");
+    for (void (*report)() : lvgl_stats_reports)
+      report();
+#ifdef LVGL_RENDER_TASK
+    if (lvgl_queue_drops > 0)
+      ESP_LOGW("lvgl", "%u commands or events lost to full queues", (unsigned)lvgl_queue_drops.load());
+#endif
+#ifdef LVGL_USE_MEM_POOL
+    ESP_LOGD("lvgl", "memory pool: %u slab, %u TLSF, %u overflow allocations, %u failed, %u slab bytes free",
+             (unsigned)mem_pool.stats.slab_allocs, (unsigned)mem_pool.stats.tlsf_allocs,
+             (unsigned)mem_pool.stats.overflow_allocs, (unsigned)mem_pool.stats.failed,
+             (unsigned)lv_mem_pool_slab_free());
+#endif
+#ifdef LVGL_SHADOW_FB
+    uint64_t offered = flush_stats.pixels + flush_stats.skipped;
+    ESP_LOGD("lvgl", "shadow framebuffer: %u kB of %u kB not sent (%.1f%%)",
+             (unsigned)(flush_stats.skipped * sizeof(lv_color_t) / 1024), (unsigned)(offered * sizeof(lv_color_t) / 1024),
+             offered ? 100.0f * flush_stats.skipped / offered : 0.0f);
+#endif
+#ifdef LVGL_GLYPH_CACHE
+    uint32_t lookups = glyph_cache.stats.hits + glyph_cache.stats.misses;
+    ESP_LOGD("lvgl", "glyph cache: %u hits, %u misses (%.1f%% hit), %u evictions, %u bytes",
+             (unsigned)glyph_cache.stats.hits, (unsigned)glyph_cache.stats.misses,
+             lookups ? 100.0f * glyph_cache.stats.hits / lookups : 0.0f, (unsigned)glyph_cache.stats.evictions,
+             (unsigned)glyph_cache.get_bytes());
+#endif
+#ifdef LVGL_IMG_CACHE
+    ESP_LOGD("lvgl", "image cache: %u hits, %u misses, %u evictions, %u too big, %u images in %u bytes",
+             (unsigned)image_cache.stats.hits, (unsigned)image_cache.stats.misses,
+             (unsigned)image_cache.stats.evictions, (unsigned)image_cache.stats.too_big, image_cache.get_count(),
+             (unsigned)image_cache.get_bytes());
+#endif
+#ifdef LVGL_SNAPSHOT
+    ESP_LOGD("lvgl", "snapshots: %u taken, %u dropped by changes, %u bytes", (unsigned)snapshot_stats.taken,
+             (unsigned)snapshot_stats.invalidations, (unsigned)snapshot_stats.bytes);
+#endif
+    if (draw_buffers.stats.refreshes > 0)
+      ESP_LOGD("lvgl", "draw buffer: %u of %u lines%s%s, %u us render and %u us flush per refresh",
+               draw_buffers.get_lines(), draw_buffers.get_max_lines(), draw_buffers.in_psram() ? " in PSRAM" : "",
+               draw_buffers.is_adaptive() ? ", adaptive" : ", fixed",
+               (unsigned)(draw_buffers.stats.render_us / draw_buffers.stats.refreshes),
+               (unsigned)(draw_buffers.stats.flush_us / draw_buffers.stats.refreshes));
+    if (draw_buffers.is_adaptive())
+      ESP_LOGD("lvgl", "stripe height: %u grows, %u shrinks since boot", (unsigned)draw_buffers.stats.grows,
+               (unsigned)draw_buffers.stats.shrinks);
+    draw_buffers.stats.refreshes = draw_buffers.stats.render_us = draw_buffers.stats.flush_us = 0;
+    this->busy_us_ = 0;
+    this->report_start_ = now;
+  }
+
+  bool tft_setup()
   {
     // This will be called once to set up the component
     // think of it as the setup() call in Arduino
-    tft.begin();
-    tft.setSwapBytes(true); /* set endianess */
-    tft.setRotation(TFT_ROTATION);
+    tft_init(tft);
+#ifdef USE_DMA_TO_TFT
+    bool dma = true;
+#else
+    bool dma = false;
+#endif
+    if (!draw_buffers.allocate(TFT_WIDTH, TFT_HEIGHT, dma))
+      return false;
+#ifdef LVGL_SHADOW_FB
+    shadow_fb.attach(draw_buffers.allocate_shadow(TFT_WIDTH, TFT_HEIGHT), TFT_WIDTH, TFT_HEIGHT, LVGL_WINDOW_COST_PX);
+    if (!shadow_fb.enabled())
+      ESP_LOGW("lvgl", "No memory for the shadow framebuffer, sending whole areas");
+#endif
+    boot_mark(BOOT_TFT);
     tft_splashscreen();
+    boot_mark(BOOT_SPLASH);
     uint16_t calData[5] = {TOUCH_CAL_DATA};
     tft.setTouch(calData);
+    boot_mark(BOOT_TOUCH);
 
-    delay(250);
+    // No delay here, loop() holds back the first frame until the splash has been visible long enough
+    return true;
   }
 
   void tft_splashscreen()
   {
     uint8_t fg[] = logoFgColor;
     uint8_t bg[] = logoBgColor;
-    lv_color_t fgColor = lv_color_make(fg[0], fg[1], fg[2]);
-    lv_color_t bgColor = lv_color_make(bg[0], bg[1], bg[2]);
+    // Plain RGB565, independent of the lvgl byte order, tft_splash converts it for pushPixels
+    uint16_t fgColor = tft.color565(fg[0], fg[1], fg[2]);
+    uint16_t bgColor = tft.color565(bg[0], bg[1], bg[2]);
 
-    tft.fillScreen(bgColor.full);
-    int x = (tft.width() - logoWidth) / 2;
-    int y = (tft.height() - logoHeight) / 2;
-    tft.drawXBitmap(x, y, logoImage, logoWidth, logoHeight, fgColor.full);
+    // lvgl does not use the draw buffer yet, the logo rows are built in it
+    uint32_t scratch_px;
+    uint16_t *scratch = draw_buffers.scratch(&scratch_px);
+    tft_splash(tft, fgColor, bgColor, scratch, scratch_px);
   }
 };
 
+/* Send pixels to the current window, by DMA the transfer may still run when this returns */
+static void IRAM_ATTR gui_push(uint16_t *data, size_t len)
+{
+#ifdef USE_DMA_TO_TFT
+  if (draw_buffers.bounce != NULL)
+  {
+    /* The SPI DMA cannot read PSRAM, copy through the two halves of the internal bounce buffer */
+    uint32_t half = draw_buffers.bounce_px / 2;
+    uint16_t *dst = draw_buffers.bounce;
+    for (size_t done = 0; done < len;)
+    {
+      uint32_t n = LV_MIN(half, len - done);
+      memcpy(dst, data + done, n * sizeof(uint16_t));
+      tft.pushPixelsDMA(dst, n); /* waits for the transfer out of the other half */
+      dst = (dst == draw_buffers.bounce) ? draw_buffers.bounce + half : draw_buffers.bounce;
+      done += n;
+    }
+  }
+  else
+    tft.pushPixelsDMA(data, len); /* Write words at once */
+#else
+  tft.pushPixels(data, len); /* Write words at once */
+#endif
+}
+
 /* Update the TFT - Needs to be accessible from C library */
 void IRAM_ATTR gui_flush_cb(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_p)
 {
+  uint32_t start = micros();
   size_t len = lv_area_get_size(area);
 
+  flush_stats.flushes++;
+
   /* Update TFT */
-  tft.startWrite();                                      /* Start new TFT transaction */
-  tft.setWindow(area->x1, area->y1, area->x2, area->y2); /* set the working window */
+  if (!tft_writing)
+  {
+    tft.startWrite(); /* Start new TFT transaction, kept open for the remaining areas of this refresh */
+    tft_writing = true;
+    flush_stats.transactions++;
+  }
+#ifdef LVGL_SHADOW_FB
+  /* Only send the pixels that differ from what the panel shows */
+  uint32_t sent = len;
+  int16_t rects = shadow_fb.enabled() ? shadow_fb.diff(area, (uint16_t *)color_p, &sent) : -1;
+  for (int16_t i = 0; i < rects; i++)
+  {
+    const shadow_rect_t &r = shadow_fb.rects[i];
 #ifdef USE_DMA_TO_TFT
-  tft.pushPixelsDMA((uint16_t *)color_p, len); /* Write words at once */
-#else
-  tft.pushPixels((uint16_t *)color_p, len); /* Write words at once */
+    tft.dmaWait(); /* the window can only move once the previous rect is out */
+#endif
+    tft.setWindow(r.x1, r.y1, r.x2, r.y2);
+    gui_push((uint16_t *)color_p + r.offset, (r.x2 - r.x1 + 1) * (r.y2 - r.y1 + 1));
+  }
+  if (rects >= 0)
+  {
+    flush_stats.windows += rects;
+    flush_stats.pixels += sent;
+    flush_stats.skipped += len - sent;
+  }
+  else
 #endif
-  tft.endWrite(); /* terminate TFT transaction */
+  {
+    flush_stats.windows++;
+    flush_stats.pixels += len;
+    tft.setWindow(area->x1, area->y1, area->x2, area->y2); /* set the working window */
+    gui_push((uint16_t *)color_p, len);
+  }
+#ifdef USE_DMA_TO_TFT
+  /* lvgl is told by gui_flush_poll() once the transfer completes,
+     meanwhile lvgl renders the next area into the other buffer */
+  dma_flush_last = lv_disp_flush_is_last(disp);
+  dma_flush_pending = disp;
+  draw_buffers.add_flush(micros() - start, len, lv_area_get_width(area), disp->draw_buf->size);
+#else
+  if (lv_disp_flush_is_last(disp))
+    gui_flush_end_write();
+  boot_mark(BOOT_FIRST_FLUSH);
+  draw_buffers.add_flush(micros() - start, len, lv_area_get_width(area), disp->draw_buf->size);
 
   /* Tell lvgl that flushing is done */
   lv_disp_flush_ready(disp);
+#endif
 }
 
-/*Read the touchpad - Needs to be accessible from C library */
-void IRAM_ATTR my_touchpad_read(lv_indev_drv_t *indev_driver, lv_indev_data_t *data)
+/* Terminate the TFT transaction of the current refresh */
+void IRAM_ATTR gui_flush_end_write()
 {
-  uint16_t touchX, touchY;
+  if (tft_writing)
+  {
+    tft.endWrite();
+    tft_writing = false;
+  }
+}
 
-  bool touched = tft.getTouch(&touchX, &touchY, 600);
+/* Finish a pending DMA flush, returns false while the transfer is still running and wait is not set */
+bool IRAM_ATTR gui_flush_poll(bool wait)
+{
+#ifdef USE_DMA_TO_TFT
+  lv_disp_drv_t *disp = dma_flush_pending;
+  if (disp == NULL)
+    return true;
 
-  if (!touched)
+  if (tft.dmaBusy())
   {
-    data->state = LV_INDEV_STATE_REL;
+    if (!wait)
+      return false;
+    tft.dmaWait();
   }
-  else
+
+  dma_flush_pending = NULL;
+  if (dma_flush_last)
+    gui_flush_end_write();
+  boot_mark(BOOT_FIRST_FLUSH);
+
+  /* Tell lvgl that flushing is done */
+  lv_disp_flush_ready(disp);
+#endif
+  return true;
+}
+
+/* Called by lvgl while it waits for the other buffer to be flushed */
+void IRAM_ATTR gui_flush_wait_cb(lv_disp_drv_t *disp)
+{
+  uint32_t start = micros();
+  gui_flush_poll(true);
+  draw_buffers.add_wait(micros() - start);
+}
+
+/* Merge invalidated areas when one bigger window is cheaper to render and send than separate ones.
+   lvgl itself only joins areas that overlap and only when that saves pixels, it does not know about
+   the setWindow and transaction overhead of every flush. */
+static void IRAM_ATTR gui_join_areas(lv_disp_t *disp)
+{
+  bool joined;
+  do
   {
-    data->state = LV_INDEV_STATE_PR;
+    joined = false;
+    for (uint16_t i = 0; i < disp->inv_p; i++)
+    {
+      if (disp->inv_area_joined[i])
+        continue;
+
+      for (uint16_t j = i + 1; j < disp->inv_p; j++)
+      {
+        if (disp->inv_area_joined[j])
+          continue;
+
+        lv_area_t merged;
+        _lv_area_join(&merged, &disp->inv_areas[i], &disp->inv_areas[j]);
+        if (lv_area_get_size(&merged) <
+            lv_area_get_size(&disp->inv_areas[i]) + lv_area_get_size(&disp->inv_areas[j]) + LVGL_WINDOW_COST_PX)
+        {
+          lv_area_copy(&disp->inv_areas[i], &merged);
+          disp->inv_area_joined[j] = 1;
+          flush_stats.joined++;
+          joined = true;
+        }
+      }
+    }
+  } while (joined); /* a grown area can now be worth merging with an earlier one */
+}
 
-    /*Set the coordinates*/
-    data->point.x = touchX;
-    data->point.y = touchY;
+/* Display refresh timer - replaces the lvgl timer callback to join areas first */
+void IRAM_ATTR gui_refr_timer_cb(lv_timer_t *timer)
+{
+  lv_disp_t *disp = (lv_disp_t *)timer->user_data;
+  gui_join_areas(disp);
 
-    // Serial.print("Data x");
-    // Serial.print(touchX);
+  uint32_t area = 0;
+  for (uint16_t i = 0; i < disp->inv_p; i++)
+    if (!disp->inv_area_joined[i])
+      area += lv_area_get_size(&disp->inv_areas[i]);
+  uint64_t pixels = flush_stats.pixels;
 
-    // Serial.print(" - y");
-    // Serial.println(touchY);
+  draw_buffers.refresh_begin();
+  _lv_disp_refr_timer(timer);
+  if (draw_buffers.refresh_end(disp->driver->draw_buf)) /* adapt the stripe height for the next refresh */
+  {
+    lvgl_perf.frames++;
+    lvgl_perf.render_us.add(draw_buffers.last_render_us);
+    lvgl_perf.flush_us.add(draw_buffers.last_flush_us);
+    lvgl_perf.bytes.add((uint32_t)(flush_stats.pixels - pixels) * sizeof(lv_color_t));
+    lvgl_perf.area_px.add(area);
   }
+#ifdef LVGL_SHADOW_FB
+  shadow_fb.end_refresh();
+#endif
+
+#ifdef USE_DMA_TO_TFT
+  if (dma_flush_pending == NULL)
+#endif
+    gui_flush_end_write(); /* in case the last area was not flagged as such */
+}
+
+/*Read the touchpad - Needs to be accessible from C library */
+void IRAM_ATTR my_touchpad_read(lv_indev_drv_t *indev_driver, lv_indev_data_t *data)
+{
+  /* The sampler reads the controller from LvglComponent::loop, here only the filtered result is returned */
+  ((TouchSampler *)indev_driver->user_data)->get(data);
 }
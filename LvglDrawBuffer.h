@@ -0,0 +1,257 @@
+#pragma once
+
+#include "esphome.h"
+#include "lvgl.h"
+#ifdef ARDUINO_ARCH_ESP32
+#include "esp_heap_caps.h"
+#endif
+
+#ifndef LVGL_DRAW_BUF_LINES
+#define LVGL_DRAW_BUF_LINES (TFT_HEIGHT / 5) /* rows per draw buffer in internal RAM */
+#endif
+#ifndef LVGL_DRAW_BUF_MIN_LINES
+#define LVGL_DRAW_BUF_MIN_LINES 8 /* lower limit of the adaptive stripe height and of the allocation fallback */
+#endif
+#ifndef LVGL_BOUNCE_LINES
+#define LVGL_BOUNCE_LINES 8 /* rows of the internal DMA buffer a PSRAM frame is sent through, in two halves */
+#endif
+
+/* Draw buffers of lvgl, allocated at runtime in internal RAM or PSRAM.
+   - internal: one stripe buffer, or two with USE_DMA_TO_TFT so lvgl renders while the other one is sent
+   - psram: one full frame buffer, with USE_DMA_TO_TFT the flush copies it through a small internal
+     bounce buffer because the SPI DMA cannot read PSRAM
+   lvgl renders at most lines rows per flush. With two internal buffers the stripe height follows the
+   measured render and flush times between refreshes, within the allocated rows. */
+class LvglDrawBuffers
+{
+public:
+  struct Stats
+  {
+    uint32_t refreshes; /* refreshes since the last report */
+    uint32_t render_us; /* time lvgl spent rendering during them */
+    uint32_t flush_us;  /* time spent in gui_flush_cb and waiting for the TFT */
+    uint32_t grows;     /* stripe height increases since boot */
+    uint32_t shrinks;   /* stripe height decreases since boot */
+  } stats = {};
+
+  lv_color_t *buf1 = NULL;
+  lv_color_t *buf2 = NULL;   /* second buffer for DMA, NULL with a single buffer */
+  uint16_t *bounce = NULL;   /* internal DMA buffer, NULL unless a PSRAM buffer is sent by DMA */
+  uint32_t bounce_px = 0;
+  uint32_t last_render_us = 0; /* of the last refresh that flushed something */
+  uint32_t last_flush_us = 0;
+
+  // Settings, from LvglComponent::set_draw_buffer before setup
+  void configure(uint16_t lines, bool psram, bool adaptive)
+  {
+    this->want_lines_ = lines ? lines : LVGL_DRAW_BUF_LINES;
+    this->want_psram_ = psram;
+    this->adaptive_ = adaptive;
+  }
+
+  /* Allocate the buffers, falling back to internal RAM and to fewer rows when memory is short */
+  bool allocate(uint16_t width, uint16_t height, bool dma)
+  {
+    this->width_ = width;
+    if (this->want_psram_ && allocate_psram(width, height, dma))
+      return true;
+    if (this->want_psram_)
+      ESP_LOGW("lvgl", "No PSRAM for a %ux%u frame buffer, using internal RAM", width, height);
+
+    uint16_t min_lines = LV_MIN(LVGL_DRAW_BUF_MIN_LINES, height);
+    uint16_t lines = LV_MIN(this->want_lines_, height);
+    if (lines < min_lines)
+    {
+      ESP_LOGE("lvgl", "Draw buffers of %u lines are below LVGL_DRAW_BUF_MIN_LINES, using %u", lines, min_lines);
+      lines = this->want_lines_ = min_lines;
+    }
+    // Halve the rows while memory is short, the last try is min_lines
+    for (;; lines = LV_MAX(lines / 2, min_lines))
+    {
+      size_t bytes = (size_t)width * lines * sizeof(lv_color_t);
+      this->buf1 = (lv_color_t *)alloc(bytes, false);
+      this->buf2 = dma ? (lv_color_t *)alloc(bytes, false) : NULL;
+      if (this->buf1 != NULL && (this->buf2 != NULL || !dma))
+        break;
+
+      free_buffer(this->buf1);
+      free_buffer(this->buf2);
+      this->buf1 = this->buf2 = NULL;
+      if (lines == min_lines)
+      {
+        ESP_LOGE("lvgl", "No memory for the draw buffers, not even for %u lines", lines);
+        return false;
+      }
+    }
+    if (lines < this->want_lines_)
+      ESP_LOGW("lvgl", "Draw buffers reduced to %u lines", lines);
+
+    // With one buffer rendering and flushing take turns, the tallest stripe has the least window overhead
+    // and there is nothing to adapt. With two, start half way so the stripes can grow as well as shrink.
+    if (this->buf2 == NULL)
+      this->adaptive_ = false;
+    this->cap_lines_ = lines;
+    this->lines_ = this->adaptive_ ? LV_MAX(lines / 2, min_lines) : lines;
+    this->psram_ = false;
+    return true;
+  }
+
+  void init(lv_disp_draw_buf_t *draw_buf)
+  {
+    lv_disp_draw_buf_init(draw_buf, this->buf1, this->buf2, (uint32_t)this->width_ * this->lines_);
+  }
+
+  /* Buffer the boot splash is built in, DMA capable when DMA is used */
+  uint16_t *scratch(uint32_t *px)
+  {
+    if (this->bounce != NULL)
+    {
+      *px = this->bounce_px;
+      return this->bounce;
+    }
+    *px = (uint32_t)this->width_ * this->cap_lines_;
+    return (uint16_t *)this->buf1;
+  }
+
+  /* Copy of the panel contents for LVGL_SHADOW_FB, in PSRAM when there is some */
+  uint16_t *allocate_shadow(uint16_t width, uint16_t height)
+  {
+    uint16_t *fb = (uint16_t *)alloc((size_t)width * height * sizeof(uint16_t), true);
+    return fb != NULL ? fb : (uint16_t *)alloc((size_t)width * height * sizeof(uint16_t), false);
+  }
+
+  uint16_t get_lines() { return this->lines_; }
+  uint16_t get_max_lines() { return this->cap_lines_; }
+  /* Whether the stripe height follows the render and flush times, only with two internal buffers */
+  bool is_adaptive() { return this->adaptive_; }
+  bool in_psram() { return this->psram_; }
+
+  /* Timing of a refresh, called from the flush path */
+  void IRAM_ATTR refresh_begin()
+  {
+    this->refresh_start_ = micros();
+    this->flush_us_ = 0;
+    this->flushes_ = 0;
+    this->cut_ = false;
+  }
+  void IRAM_ATTR add_flush(uint32_t us, uint32_t len, lv_coord_t area_w, uint32_t size)
+  {
+    this->flush_us_ += us;
+    this->flushes_++;
+    if (len + area_w > size)
+      this->cut_ = true; // the area did not fit, lvgl split it at the stripe height
+  }
+  void IRAM_ATTR add_wait(uint32_t us) { this->flush_us_ += us; }
+
+  /* Returns false when the refresh did not flush anything.
+     Grow the stripes while flushing dominates, fewer and larger windows have less overhead.
+     Shrink them while rendering dominates and DMA overlaps both, the transfer of the last stripe
+     is not hidden behind rendering and gets shorter. */
+  bool IRAM_ATTR refresh_end(lv_disp_draw_buf_t *draw_buf)
+  {
+    if (this->flushes_ == 0)
+      return false;
+
+    uint32_t total = micros() - this->refresh_start_;
+    uint32_t render = total > this->flush_us_ ? total - this->flush_us_ : 0;
+    this->last_render_us = render;
+    this->last_flush_us = this->flush_us_;
+    this->stats.refreshes++;
+    this->stats.render_us += render;
+    this->stats.flush_us += this->flush_us_;
+
+    // Only refreshes that were cut into stripes tell something about the stripe height
+    if (!this->adaptive_ || !this->cut_)
+      return true;
+
+    int8_t verdict = 0;
+    if (this->flush_us_ > render && this->lines_ < this->cap_lines_)
+      verdict = 1;
+    else if (this->buf2 != NULL && this->flush_us_ * 2 < render && this->lines_ > LVGL_DRAW_BUF_MIN_LINES)
+      verdict = -1;
+
+    // Act after three refreshes in a row agree
+    this->votes_ = (verdict != 0 && (this->votes_ > 0) == (verdict > 0)) ? this->votes_ + verdict : verdict;
+    if (this->votes_ > -3 && this->votes_ < 3)
+      return true;
+
+    uint16_t step = LV_MAX(this->lines_ / 4, 1);
+    if (this->votes_ > 0)
+    {
+      this->lines_ = LV_MIN(this->lines_ + step, this->cap_lines_);
+      this->stats.grows++;
+    }
+    else
+    {
+      this->lines_ = LV_MAX(this->lines_ - step, LVGL_DRAW_BUF_MIN_LINES);
+      this->stats.shrinks++;
+    }
+    this->votes_ = 0;
+    draw_buf->size = (uint32_t)this->width_ * this->lines_; // lvgl reads it for the next area
+    return true;
+  }
+
+private:
+  uint16_t want_lines_ = LVGL_DRAW_BUF_LINES;
+#ifdef LVGL_DRAW_BUF_PSRAM
+  bool want_psram_ = true;
+#else
+  bool want_psram_ = false;
+#endif
+  bool adaptive_ = true;
+
+  uint16_t width_ = 0;
+  uint16_t cap_lines_ = 0;
+  uint16_t lines_ = 0;
+  bool psram_ = false;
+
+  uint32_t refresh_start_ = 0;
+  uint32_t flush_us_ = 0;
+  uint16_t flushes_ = 0;
+  bool cut_ = false;
+  int8_t votes_ = 0;
+
+  bool allocate_psram(uint16_t width, uint16_t height, bool dma)
+  {
+    this->buf1 = (lv_color_t *)alloc((size_t)width * height * sizeof(lv_color_t), true);
+    if (this->buf1 == NULL)
+      return false;
+
+    if (dma)
+    {
+      this->bounce_px = (uint32_t)width * LVGL_BOUNCE_LINES;
+      this->bounce = (uint16_t *)alloc(this->bounce_px * sizeof(uint16_t), false);
+      if (this->bounce == NULL)
+      {
+        free_buffer(this->buf1);
+        this->buf1 = NULL;
+        this->bounce_px = 0;
+        return false;
+      }
+    }
+    this->cap_lines_ = this->lines_ = height;
+    this->adaptive_ = false; // whole frames, nothing is cut into stripes
+    this->psram_ = true;
+    return true;
+  }
+
+  static void *alloc(size_t bytes, bool psram)
+  {
+#ifdef ARDUINO_ARCH_ESP32
+    if (psram)
+      return heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return heap_caps_malloc(bytes, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+#else
+    return malloc(bytes); // no PSRAM distinction, the simulator still exercises the bounce path
+#endif
+  }
+
+  static void free_buffer(void *p)
+  {
+#ifdef ARDUINO_ARCH_ESP32
+    heap_caps_free(p);
+#else
+    free(p);
+#endif
+  }
+};
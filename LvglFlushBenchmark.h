@@ -0,0 +1,209 @@
+#pragma once
+
+#include "esphome.h"
+#include "lvgl.h"
+#include "LvglComponent.h"
+
+/* Synthetic dirty areas, each case covers the whole screen with w x h areas */
+struct flush_bench_case_t
+{
+  const char *name;
+  lv_coord_t w; /* 0 = screen width */
+  lv_coord_t h; /* 0 = screen height, -1 = rows of one draw buffer */
+};
+
+static const flush_bench_case_t flush_bench_cases[] = {
+    {"full", 0, 0},    // only runs when the draw buffer holds a whole frame
+    {"stripe", 0, -1}, // what lvgl sends for a full redraw
+    {"row", 0, 1},
+    {"tile16", 16, 16},
+};
+
+// Drives gui_flush_cb directly and logs one JSON line per case, for example:
+// {"case":"stripe","w":240,"h":64,"frames":3,"calls":15,"windows_per_frame":5.0,"transactions_per_frame":1.0,...}
+// followed by the CPU cost of the byte swap that LV_COLOR_16_SWAP avoids:
+// {"case":"byte_swap","frames":3,"ns_per_px":1.25,"us_per_frame":96,"active":true}
+// and with LVGL_IMG_CACHE the redraw time of an icon grid with the image cache off and on:
+// {"case":"image_cache","icons":16,"frames":3,"us_per_frame_uncached":5200,"us_per_frame_cached":2100,...}
+class LvglFlushBenchmark : public Component
+{
+public:
+  LvglFlushBenchmark(uint8_t frames = 3) { this->frames_ = frames; }
+
+  void loop() override
+  {
+    // Run once, after all widgets have been set up
+    if (this->done_)
+      return;
+    this->done_ = true;
+    lvgl_call(run_cb, this, 0); // in the render task when lvgl has one
+  }
+  float get_setup_priority() const override { return esphome::setup_priority::LATE; }
+
+  void run()
+  {
+    lv_disp_t *disp = lv_disp_get_default();
+    if (disp == NULL)
+      return;
+
+    gui_flush_poll(true); // don't measure a transfer that lvgl started
+
+    for (size_t c = 0; c < sizeof(flush_bench_cases) / sizeof(flush_bench_cases[0]); c++)
+      run_case(disp, flush_bench_cases[c]);
+    run_byte_swap(disp);
+#ifdef LVGL_IMG_CACHE
+    run_image_cache(disp);
+#endif
+
+    lv_obj_invalidate(lv_scr_act()); // restore the ui
+  }
+
+private:
+  uint8_t frames_;
+
+  static void run_cb(void *self, int32_t) { ((LvglFlushBenchmark *)self)->run(); }
+
+  // The swap TFT_eSPI does on every pushed pixel with setSwapBytes(true), active tells if this build pays it
+  void run_byte_swap(lv_disp_t *disp)
+  {
+    lv_disp_draw_buf_t *draw_buf = disp->driver->draw_buf;
+    uint16_t *p = (uint16_t *)draw_buf->buf1;
+    uint32_t len = draw_buf->size;
+    uint32_t screen = (uint32_t)disp->driver->hor_res * disp->driver->ver_res;
+
+    uint32_t t = micros();
+    for (uint8_t frame = 0; frame < this->frames_; frame++)
+      for (uint32_t i = 0; i < len; i++)
+        p[i] = (uint16_t)((p[i] << 8) | (p[i] >> 8));
+    uint32_t us = micros() - t;
+
+    float ns_per_px = us * 1000.0f / ((float)len * this->frames_);
+    ESP_LOGI("lvgl.bench", "{\"case\":\"byte_swap\",\"frames\":%u,\"ns_per_px\":%.2f,\"us_per_frame\":%.0f,\"active\":%s}",
+             this->frames_, ns_per_px, ns_per_px * screen / 1000.0f, tft.getSwapBytes() ? "true" : "false");
+  }
+#ifdef LVGL_IMG_CACHE
+  // Full redraws of a grid of 16 color indexed icons, which lvgl decodes line by line without the cache,
+  // through the palette. Every icon has its own source, as different icons would, so lvgl's one entry
+  // cache cannot help.
+  void run_image_cache(lv_disp_t *disp)
+  {
+    const lv_coord_t size = 48;
+    const uint8_t cols = 4, rows = 4;
+    const uint32_t palette_size = 16 * sizeof(lv_color32_t);
+    uint32_t data_size = palette_size + size * size / 2;
+    uint8_t *indexed = (uint8_t *)malloc(data_size);
+    if (indexed == NULL)
+      return;
+    lv_color32_t *palette = (lv_color32_t *)indexed;
+    for (uint8_t i = 0; i < 16; i++)
+      palette[i].full = lv_color_to32(lv_color_hsv_to_rgb(i * 22, 80, 90));
+    palette[0].full = 0; // transparent background, as icons have
+    uint8_t *pixels = indexed + palette_size;
+    for (lv_coord_t y = 0; y < size; y++)
+      for (lv_coord_t x = 0; x < size; x += 2)
+        pixels[(y * size + x) / 2] = (uint8_t)((((x * y + x) >> 4) & 0x0F) << 4 | (((x * y + y) >> 4) & 0x0F));
+
+    lv_img_dsc_t icons[cols * rows];
+    lv_obj_t *prev = lv_scr_act();
+    lv_obj_t *scr = lv_obj_create(NULL);
+    lv_scr_load(scr);
+    for (uint8_t i = 0; i < cols * rows; i++)
+    {
+      memset(&icons[i], 0, sizeof(icons[i]));
+      icons[i].header.cf = LV_IMG_CF_INDEXED_4BIT;
+      icons[i].header.w = size;
+      icons[i].header.h = size;
+      icons[i].data_size = data_size;
+      icons[i].data = indexed;
+      lv_obj_t *img = lv_img_create(scr);
+      lv_img_set_src(img, &icons[i]);
+      lv_obj_set_pos(img, (i % cols) * (size + 8), (i / cols) * (size + 8));
+    }
+
+    uint32_t us[2];
+    ImageCache::Stats start = image_cache.stats;
+    for (uint8_t cached = 0; cached < 2; cached++)
+    {
+      image_cache.set_enabled(cached);
+      lv_obj_invalidate(scr);
+      lv_refr_now(disp); // fill the cache, not measured
+      uint32_t t = micros();
+      for (uint8_t frame = 0; frame < this->frames_; frame++)
+      {
+        lv_obj_invalidate(scr);
+        lv_refr_now(disp);
+      }
+      us[cached] = micros() - t;
+    }
+    image_cache.set_enabled(true);
+
+    uint32_t misses = image_cache.stats.misses - start.misses;
+    ESP_LOGI("lvgl.bench",
+             "{\"case\":\"image_cache\",\"icons\":%u,\"frames\":%u,\"us_per_frame_uncached\":%u,"
+             "\"us_per_frame_cached\":%u,\"hits\":%u,\"misses\":%u}",
+             cols * rows, this->frames_, (unsigned)(us[0] / this->frames_), (unsigned)(us[1] / this->frames_),
+             (unsigned)(image_cache.stats.hits - start.hits), (unsigned)misses);
+    if (misses == 0)
+      ESP_LOGW("lvgl.bench", "No icon went through the image cache, both timings are uncached");
+
+    lv_scr_load(prev);
+    lv_obj_del(scr);
+    for (uint8_t i = 0; i < cols * rows; i++)
+      image_cache.invalidate(&icons[i]); // the descriptors are on the stack
+    free(indexed);
+  }
+#endif
+  bool done_ = false;
+
+  void run_case(lv_disp_t *disp, const flush_bench_case_t &bench)
+  {
+    lv_disp_draw_buf_t *draw_buf = disp->driver->draw_buf;
+    lv_coord_t hor_res = disp->driver->hor_res;
+    lv_coord_t ver_res = disp->driver->ver_res;
+    lv_coord_t w = bench.w > 0 ? bench.w : hor_res;
+    lv_coord_t h = bench.h > 0 ? bench.h : (bench.h < 0 ? draw_buf->size / hor_res : ver_res);
+
+    if ((uint32_t)w * h > draw_buf->size)
+    {
+      ESP_LOGD("lvgl.bench", "{\"case\":\"%s\",\"skipped\":\"area exceeds draw buffer\"}", bench.name);
+      return;
+    }
+
+    // Pattern that changes per frame, so nothing can be optimized away downstream
+    lv_color_t *color_p = (lv_color_t *)draw_buf->buf1;
+
+    flush_stats_t start = flush_stats;
+    uint32_t call_us = 0;
+
+    for (uint8_t frame = 0; frame < this->frames_; frame++)
+    {
+      for (uint32_t i = 0; i < (uint32_t)w * h; i++)
+        color_p[i].full = (uint16_t)(i + frame * 0x0841);
+
+      for (lv_coord_t y = 0; y < ver_res; y += h)
+        for (lv_coord_t x = 0; x < hor_res; x += w)
+        {
+          lv_area_t area;
+          lv_area_set(&area, x, y, LV_MIN(x + w, hor_res) - 1, LV_MIN(y + h, ver_res) - 1);
+          draw_buf->flushing_last = (area.x2 == hor_res - 1 && area.y2 == ver_res - 1); // last area of the frame
+
+          uint32_t t = micros();
+          gui_flush_cb(disp->driver, &area, color_p);
+          gui_flush_poll(true); // lvgl would wait here before reusing the buffer
+          call_us += micros() - t;
+        }
+    }
+
+    uint32_t calls = flush_stats.flushes - start.flushes;
+    uint32_t windows = flush_stats.windows - start.windows;
+    uint32_t transactions = flush_stats.transactions - start.transactions;
+    uint32_t pixels = (uint32_t)(flush_stats.pixels - start.pixels);
+
+    ESP_LOGI("lvgl.bench",
+             "{\"case\":\"%s\",\"w\":%d,\"h\":%d,\"frames\":%u,\"calls\":%u,\"windows_per_frame\":%.1f,"
+             "\"transactions_per_frame\":%.1f,\"bytes\":%u,\"us_per_call\":%.1f,\"us_per_frame\":%.0f,\"mpix_per_s\":%.2f}",
+             bench.name, w, h, this->frames_, (unsigned)calls, (float)windows / this->frames_,
+             (float)transactions / this->frames_, (unsigned)(pixels * sizeof(lv_color_t)), (float)call_us / calls,
+             (float)call_us / this->frames_, (float)pixels / call_us);
+  }
+};
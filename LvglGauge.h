@@ -0,0 +1,30 @@
+#pragma once
+
+#include "esphome.h"
+#include "lvgl.h"
+#include "LvglValueWidget.h"
+
+// lvgl 8 draws gauges with lv_meter: a 270 degree scale with one needle, kept in the object's user data
+struct LvglGaugeTraits
+{
+  static lv_obj_t *create(lv_obj_t *parent, int32_t min, int32_t max)
+  {
+    lv_obj_t *obj = lv_meter_create(parent);
+    lv_meter_scale_t *scale = lv_meter_add_scale(obj);
+    lv_meter_set_scale_ticks(obj, scale, 21, 2, 10, lv_palette_main(LV_PALETTE_GREY));
+    lv_meter_set_scale_major_ticks(obj, scale, 5, 4, 15, lv_color_black(), 10);
+    lv_meter_set_scale_range(obj, scale, min, max, 270, 135);
+    lv_meter_indicator_t *needle = lv_meter_add_needle_line(obj, scale, 4, lv_palette_main(LV_PALETTE_BLUE), -10);
+    lv_obj_set_user_data(obj, needle);
+    return obj;
+  }
+  static int32_t get(lv_obj_t *obj) { return ((lv_meter_indicator_t *)lv_obj_get_user_data(obj))->start_value; }
+  static void set(lv_obj_t *obj, int32_t value)
+  {
+    lv_meter_set_indicator_value(obj, (lv_meter_indicator_t *)lv_obj_get_user_data(obj), value);
+  }
+};
+
+#ifdef USE_SENSOR // with a sensor: component in the yaml
+using LvglGauge = LvglSensorWidget<LvglGaugeTraits>;
+#endif
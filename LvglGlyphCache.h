@@ -0,0 +1,246 @@
+#pragma once
+
+// Decompressed glyph bitmaps of compressed fonts, enabled with -D LVGL_GLYPH_CACHE (see lv_conf.h)
+//
+// lvgl decompresses a glyph of a compressed font again every time it is drawn. lv_glyph_cache_font()
+// returns a copy of the font whose get_glyph_bitmap looks the glyph up by font and code point first.
+// Up to LVGL_GLYPH_CACHE_SIZE bytes of bitmaps are kept, the glyphs drawn least recently are dropped
+// first. Fonts with plain bitmaps are drawn straight from flash and are not wrapped.
+
+#ifdef LVGL_GLYPH_CACHE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esphome.h"
+#include "lvgl.h"
+#include "lv_glyph_cache.h"
+#ifdef ARDUINO_ARCH_ESP32
+#include "esp_heap_caps.h"
+#endif
+
+#ifndef LVGL_GLYPH_CACHE_SIZE
+#define LVGL_GLYPH_CACHE_SIZE (16 * 1024U) /* [bytes] of decompressed bitmaps */
+#endif
+#ifndef LVGL_GLYPH_CACHE_ENTRIES
+#define LVGL_GLYPH_CACHE_ENTRIES 256 /* glyphs, power of two */
+#endif
+#ifndef LVGL_GLYPH_CACHE_FONTS
+#define LVGL_GLYPH_CACHE_FONTS 8 /* compressed fonts that can be wrapped */
+#endif
+
+class GlyphCache
+{
+  static_assert((LVGL_GLYPH_CACHE_ENTRIES & (LVGL_GLYPH_CACHE_ENTRIES - 1)) == 0, "entries must be a power of two");
+
+public:
+  struct Stats
+  {
+    uint32_t hits;      /* bitmaps returned from the cache */
+    uint32_t misses;    /* bitmaps decompressed by lvgl */
+    uint32_t evictions; /* bitmaps dropped to make room */
+  } stats = {};
+
+  GlyphCache()
+  {
+    for (uint16_t i = 0; i < LVGL_GLYPH_CACHE_ENTRIES; i++)
+    {
+      this->buckets_[i] = NONE;
+      this->entries_[i].next = i + 1 < LVGL_GLYPH_CACHE_ENTRIES ? i + 1 : NONE;
+    }
+  }
+
+  uint32_t get_bytes() { return this->bytes_; }
+
+  /* Bitmap of letter in the compressed font base, decompressed once */
+  const uint8_t *bitmap(const lv_font_t *base, uint32_t letter)
+  {
+    uint16_t b = bucket(base, letter);
+    for (uint16_t i = this->buckets_[b]; i != NONE; i = this->entries_[i].next)
+    {
+      Entry &e = this->entries_[i];
+      if (e.font == base && e.letter == letter)
+      {
+        this->stats.hits++;
+        unlink_lru(i);
+        link_lru(i);
+        return e.data;
+      }
+    }
+
+    this->stats.misses++;
+    const uint8_t *src = base->get_glyph_bitmap(base, letter);
+    lv_font_glyph_dsc_t dsc;
+    if (src == NULL || !base->get_glyph_dsc(base, &dsc, letter, 0))
+      return src;
+    uint32_t size = bitmap_size(dsc);
+    if (size == 0 || size > LVGL_GLYPH_CACHE_SIZE)
+      return src;
+
+    while (this->bytes_ + size > LVGL_GLYPH_CACHE_SIZE || this->free_ == NONE)
+      evict();
+    uint8_t *data = (uint8_t *)alloc(size);
+    if (data == NULL)
+      return src; // src stays valid until lvgl decompresses the next glyph
+    memcpy(data, src, size);
+
+    uint16_t i = this->free_;
+    Entry &e = this->entries_[i];
+    this->free_ = e.next;
+    e.font = base;
+    e.letter = letter;
+    e.data = data;
+    e.size = size;
+    e.next = this->buckets_[b];
+    this->buckets_[b] = i;
+    link_lru(i);
+    this->bytes_ += size;
+    return data;
+  }
+
+private:
+  static const uint16_t NONE = 0xFFFF;
+  struct Entry
+  {
+    const lv_font_t *font;
+    uint32_t letter;
+    uint8_t *data;
+    uint32_t size;
+    uint16_t next;  /* in the bucket chain, or in the free list */
+    uint16_t newer; /* LRU list */
+    uint16_t older;
+  };
+  Entry entries_[LVGL_GLYPH_CACHE_ENTRIES];
+  uint16_t buckets_[LVGL_GLYPH_CACHE_ENTRIES];
+  uint16_t free_ = 0;
+  uint16_t newest_ = NONE;
+  uint16_t oldest_ = NONE;
+  uint32_t bytes_ = 0;
+
+  static uint16_t bucket(const lv_font_t *font, uint32_t letter)
+  {
+    uint32_t h = letter * 0x9E3779B1u + (uint32_t)(uintptr_t)font;
+    return (h ^ (h >> 16)) & (LVGL_GLYPH_CACHE_ENTRIES - 1);
+  }
+
+  /* Size lvgl decompresses a glyph to, 3 bpp glyphs are expanded to 4 bpp */
+  static uint32_t bitmap_size(const lv_font_glyph_dsc_t &dsc)
+  {
+    uint32_t px = (uint32_t)dsc.box_w * dsc.box_h;
+    switch (dsc.bpp)
+    {
+    case 1:
+      return (px + 7) >> 3;
+    case 2:
+      return (px + 3) >> 2;
+    case 3:
+    case 4:
+      return (px + 1) >> 1;
+    default:
+      return px;
+    }
+  }
+
+  void link_lru(uint16_t i)
+  {
+    this->entries_[i].older = this->newest_;
+    this->entries_[i].newer = NONE;
+    if (this->newest_ != NONE)
+      this->entries_[this->newest_].newer = i;
+    this->newest_ = i;
+    if (this->oldest_ == NONE)
+      this->oldest_ = i;
+  }
+
+  void unlink_lru(uint16_t i)
+  {
+    Entry &e = this->entries_[i];
+    if (e.newer != NONE)
+      this->entries_[e.newer].older = e.older;
+    else
+      this->newest_ = e.older;
+    if (e.older != NONE)
+      this->entries_[e.older].newer = e.newer;
+    else
+      this->oldest_ = e.newer;
+  }
+
+  void evict()
+  {
+    uint16_t i = this->oldest_;
+    Entry &e = this->entries_[i];
+    unlink_lru(i);
+
+    uint16_t *link = &this->buckets_[bucket(e.font, e.letter)];
+    while (*link != i)
+      link = &this->entries_[*link].next;
+    *link = e.next;
+
+    free_bitmap(e.data);
+    this->bytes_ -= e.size;
+    e.next = this->free_;
+    this->free_ = i;
+    this->stats.evictions++;
+  }
+
+  // In PSRAM when there is some, internal RAM is kept for the draw buffers
+  static void *alloc(size_t bytes)
+  {
+#ifdef ARDUINO_ARCH_ESP32
+    void *p = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p != NULL ? p : heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#else
+    return malloc(bytes);
+#endif
+  }
+
+  static void free_bitmap(void *p)
+  {
+#ifdef ARDUINO_ARCH_ESP32
+    heap_caps_free(p);
+#else
+    free(p);
+#endif
+  }
+};
+
+static GlyphCache glyph_cache;
+
+/* A compressed font with the cache in front of its bitmaps */
+struct glyph_cache_font_t
+{
+  lv_font_t font; /* first, lvgl only sees this part */
+  const lv_font_t *base;
+};
+static glyph_cache_font_t glyph_cache_fonts[LVGL_GLYPH_CACHE_FONTS];
+static uint8_t glyph_cache_font_count = 0;
+
+static const uint8_t *glyph_cache_get_bitmap(const lv_font_t *font, uint32_t letter)
+{
+  return glyph_cache.bitmap(((const glyph_cache_font_t *)font)->base, letter);
+}
+
+extern "C" const lv_font_t *lv_glyph_cache_font(const lv_font_t *font)
+{
+  // Only lvgl's own font format can be compressed
+  if (font == NULL || font->get_glyph_bitmap != lv_font_get_bitmap_fmt_txt ||
+      ((const lv_font_fmt_txt_dsc_t *)font->dsc)->bitmap_format == LV_FONT_FMT_TXT_PLAIN)
+    return font;
+
+  for (uint8_t i = 0; i < glyph_cache_font_count; i++)
+    if (glyph_cache_fonts[i].base == font)
+      return &glyph_cache_fonts[i].font;
+
+  if (glyph_cache_font_count == LVGL_GLYPH_CACHE_FONTS)
+  {
+    ESP_LOGW("lvgl", "No room to cache glyphs of another font, raise LVGL_GLYPH_CACHE_FONTS");
+    return font;
+  }
+  glyph_cache_font_t &cached = glyph_cache_fonts[glyph_cache_font_count++];
+  cached.font = *font;
+  cached.font.get_glyph_bitmap = glyph_cache_get_bitmap;
+  cached.base = font;
+  return &cached.font;
+}
+
+#endif // LVGL_GLYPH_CACHE
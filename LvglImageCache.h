@@ -0,0 +1,326 @@
+#pragma once
+
+// Decoded images kept within a byte budget, enabled with -D LVGL_IMG_CACHE
+//
+// lvgl's own cache holds LV_IMG_CACHE_DEF_SIZE opened images, counted in entries whatever their size.
+// With more images on screen than that, every redraw decodes them again: indexed and alpha images line
+// by line, PNG or filesystem images completely. This decoder sits in front of the others, decodes an
+// image once into a full buffer and hands that buffer out until it is evicted.
+// - the budget is in bytes, LVGL_IMG_CACHE_SIZE, in PSRAM with LVGL_IMG_CACHE_PSRAM
+// - eviction starts at the least recently opened image, images hit more than once get a second chance
+// - pinned images are never evicted, for icons that are always on screen
+// True color images stored in flash are drawn from there directly and are not cached.
+
+#ifdef LVGL_IMG_CACHE
+
+#include <stdlib.h>
+#include <string.h>
+#include "esphome.h"
+#include "lvgl.h"
+#ifdef ARDUINO_ARCH_ESP32
+#include "esp_heap_caps.h"
+#endif
+
+#ifndef LVGL_IMG_CACHE_SIZE
+#define LVGL_IMG_CACHE_SIZE (32 * 1024U) /* [bytes] of decoded images */
+#endif
+
+class ImageCache
+{
+public:
+  struct Stats
+  {
+    uint32_t hits;      /* opens served from the cache */
+    uint32_t misses;    /* images decoded */
+    uint32_t evictions; /* images dropped to make room */
+    uint32_t too_big;   /* images left to the other decoders because they do not fit */
+  } stats = {};
+
+  /* Register the decoder, after lv_init */
+  void init()
+  {
+    lv_img_decoder_t *decoder = lv_img_decoder_create(); // tried before the decoders registered earlier
+    lv_img_decoder_set_info_cb(decoder, info_cb);
+    lv_img_decoder_set_open_cb(decoder, open_cb);
+    lv_img_decoder_set_close_cb(decoder, close_cb);
+    decoder->user_data = this;
+  }
+
+  void set_size(uint32_t bytes) { this->budget_ = bytes; }
+  // Off, every open goes to the other decoders again, e.g. to measure what the cache saves
+  void set_enabled(bool enabled) { this->enabled_ = enabled; }
+
+  uint32_t get_bytes() { return this->bytes_; }
+  uint16_t get_count() { return this->count_; }
+
+  /* Decode an image now and never evict it. color is the recolor lvgl passes, black unless styled. */
+  bool pin(const void *src, lv_color_t color = lv_color_black())
+  {
+    lv_img_src_t type = lv_img_src_get_type(src);
+    Entry *e = find(src, type, color, 0);
+    if (e == NULL)
+      e = decode(src, type, color, 0);
+    if (e == NULL)
+      return false;
+    e->pinned = true;
+    return true;
+  }
+
+  void unpin(const void *src)
+  {
+    for (Entry *e = this->newest_; e != NULL; e = e->older)
+      if (same_src(e, src, lv_img_src_get_type(src)))
+        e->pinned = false;
+  }
+
+  /* Drop an image whose data has changed, from lvgl's cache as well */
+  void invalidate(const void *src)
+  {
+    lv_img_cache_invalidate_src(src);
+    lv_img_src_t type = lv_img_src_get_type(src);
+    for (Entry *e = this->newest_; e != NULL;)
+    {
+      Entry *older = e->older;
+      if (same_src(e, src, type) && e->refs == 0)
+        remove(e);
+      e = older;
+    }
+  }
+
+private:
+  struct Entry
+  {
+    const void *src; /* the lv_img_dsc_t, or a copy of the path */
+    bool file;
+    bool pinned;
+    uint8_t hits;  /* since the last second chance */
+    uint16_t refs; /* opened by lvgl and not closed yet */
+    lv_color_t color;
+    int32_t frame_id; /* frame of a multi-frame source, 0 for still images */
+    lv_img_header_t header;
+    uint8_t *data;
+    uint32_t size;
+    Entry *newer;
+    Entry *older;
+  };
+  Entry *newest_ = NULL;
+  Entry *oldest_ = NULL;
+  uint16_t count_ = 0;
+  uint32_t bytes_ = 0;
+  uint32_t budget_ = LVGL_IMG_CACHE_SIZE;
+  bool enabled_ = true;
+  bool inner_ = false; /* the other decoders are being asked, stay out of the way */
+
+  static lv_res_t info_cb(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header)
+  {
+    ImageCache *self = (ImageCache *)decoder->user_data;
+    if (self->inner_ || !self->enabled_)
+      return LV_RES_INV;
+
+    self->inner_ = true;
+    lv_res_t res = lv_img_decoder_get_info(src, header);
+    self->inner_ = false;
+    return res;
+  }
+
+  static lv_res_t open_cb(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+  {
+    ImageCache *self = (ImageCache *)decoder->user_data;
+    if (self->inner_ || !self->enabled_ || dsc->src_type == LV_IMG_SRC_SYMBOL)
+      return LV_RES_INV;
+
+    Entry *e = self->find(dsc->src, dsc->src_type, dsc->color, dsc->frame_id);
+    if (e != NULL)
+    {
+      self->stats.hits++;
+      if (e->hits < UINT8_MAX)
+        e->hits++;
+      self->unlink(e);
+      self->link(e);
+    }
+    else if ((e = self->decode(dsc->src, dsc->src_type, dsc->color, dsc->frame_id)) == NULL)
+      return LV_RES_INV; // lvgl asks the next decoder
+
+    e->refs++;
+    dsc->header = e->header;
+    dsc->img_data = e->data;
+    dsc->user_data = e;
+    return LV_RES_OK;
+  }
+
+  static void close_cb(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+  {
+    Entry *e = (Entry *)dsc->user_data;
+    if (e != NULL && e->refs > 0)
+      e->refs--;
+  }
+
+  static bool same_src(const Entry *e, const void *src, lv_img_src_t type)
+  {
+    if (type == LV_IMG_SRC_FILE)
+      return e->file && strcmp((const char *)e->src, (const char *)src) == 0;
+    return !e->file && e->src == src;
+  }
+
+  Entry *find(const void *src, lv_img_src_t type, lv_color_t color, int32_t frame_id)
+  {
+    for (Entry *e = this->newest_; e != NULL; e = e->older)
+      if (same_src(e, src, type) && e->color.full == color.full && e->frame_id == frame_id)
+        return e;
+    return NULL;
+  }
+
+  /* Decode with the other decoders into a full buffer, NULL when the image is not worth or too big to keep */
+  Entry *decode(const void *src, lv_img_src_t type, lv_color_t color, int32_t frame_id)
+  {
+    this->inner_ = true;
+    lv_img_decoder_dsc_t inner;
+    if (lv_img_decoder_open(&inner, src, color, frame_id) != LV_RES_OK)
+    {
+      this->inner_ = false;
+      return NULL;
+    }
+
+    // Pixels in the format lvgl draws decoded images in, with an alpha byte when the format has alpha
+    uint8_t px_size = lv_img_cf_has_alpha(inner.header.cf) ? LV_IMG_PX_SIZE_ALPHA_BYTE : LV_COLOR_SIZE / 8;
+    lv_coord_t w = inner.header.w;
+    uint32_t size = (uint32_t)w * inner.header.h * px_size;
+    uint8_t *data = NULL;
+
+    bool in_flash = type == LV_IMG_SRC_VARIABLE && inner.img_data == ((const lv_img_dsc_t *)src)->data;
+    if (!in_flash && size > 0)
+    {
+      if (size > this->budget_ || !make_room(size))
+        this->stats.too_big++;
+      else
+        data = (uint8_t *)alloc(size);
+    }
+    if (data != NULL)
+    {
+      if (inner.img_data != NULL)
+        memcpy(data, inner.img_data, size);
+      else
+        for (lv_coord_t y = 0; y < (lv_coord_t)inner.header.h; y++)
+          if (lv_img_decoder_read_line(&inner, 0, y, w, data + (uint32_t)y * w * px_size) != LV_RES_OK)
+          {
+            free_data(data);
+            data = NULL;
+            break;
+          }
+    }
+    // The buffer is in true color now, whatever the source format was, and lvgl draws it as its header says
+    lv_img_header_t header = inner.header;
+    if (px_size == LV_IMG_PX_SIZE_ALPHA_BYTE)
+      header.cf = LV_IMG_CF_TRUE_COLOR_ALPHA;
+    else if (header.cf != LV_IMG_CF_TRUE_COLOR_CHROMA_KEYED)
+      header.cf = LV_IMG_CF_TRUE_COLOR;
+    lv_img_decoder_close(&inner);
+    this->inner_ = false;
+    if (data == NULL)
+      return NULL;
+
+    Entry *e = new Entry();
+    e->file = type == LV_IMG_SRC_FILE;
+    e->src = e->file ? strdup((const char *)src) : src;
+    e->color = color;
+    e->frame_id = frame_id;
+    e->header = header;
+    e->data = data;
+    e->size = size;
+    link(e);
+    this->count_++;
+    this->bytes_ += size;
+    this->stats.misses++;
+    return e;
+  }
+
+  /* Evict from the oldest end until size bytes fit the budget */
+  bool make_room(uint32_t size)
+  {
+    uint16_t chances = this->count_;
+    for (Entry *e = this->oldest_; e != NULL && this->bytes_ + size > this->budget_;)
+    {
+      Entry *newer = e->newer;
+      if (e->pinned || e->refs > 0)
+        ; // in use, keep
+      else if (e->hits > 1 && chances > 0)
+      {
+        // Used often, move it to the newest end, it is visited again with half its hits
+        e->hits /= 2;
+        chances--;
+        unlink(e);
+        link(e);
+        if (newer == NULL)
+          newer = e;
+      }
+      else
+      {
+        remove(e);
+        this->stats.evictions++;
+      }
+      e = newer;
+    }
+    return this->bytes_ + size <= this->budget_;
+  }
+
+  void link(Entry *e)
+  {
+    e->newer = NULL;
+    e->older = this->newest_;
+    if (this->newest_ != NULL)
+      this->newest_->newer = e;
+    this->newest_ = e;
+    if (this->oldest_ == NULL)
+      this->oldest_ = e;
+  }
+
+  void unlink(Entry *e)
+  {
+    if (e->newer != NULL)
+      e->newer->older = e->older;
+    else
+      this->newest_ = e->older;
+    if (e->older != NULL)
+      e->older->newer = e->newer;
+    else
+      this->oldest_ = e->newer;
+  }
+
+  void remove(Entry *e)
+  {
+    unlink(e);
+    this->count_--;
+    this->bytes_ -= e->size;
+    free_data(e->data);
+    if (e->file)
+      free((void *)e->src);
+    delete e;
+  }
+
+  static void *alloc(size_t bytes)
+  {
+#ifdef ARDUINO_ARCH_ESP32
+#ifdef LVGL_IMG_CACHE_PSRAM
+    void *p = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (p != NULL)
+      return p;
+#endif
+    return heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#else
+    return malloc(bytes);
+#endif
+  }
+
+  static void free_data(void *p)
+  {
+#ifdef ARDUINO_ARCH_ESP32
+    heap_caps_free(p);
+#else
+    free(p);
+#endif
+  }
+};
+
+static ImageCache image_cache; /* registered in LvglComponent::setup */
+
+#endif // LVGL_IMG_CACHE
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <vector>
+#include "esphome.h"
+#include "lvgl.h"
+#include "LvglWidget.h"
+
+// Compact UI description that stays in flash. Text is referenced, not copied: labels use
+// lv_label_set_text_static so no string ends up in the lvgl heap.
+// On the ESP32 PROGMEM data is memory mapped and read in place.
+
+enum lvgl_layout_type_t : uint8_t
+{
+  LAYOUT_LABEL,
+  LAYOUT_SWITCH,
+  LAYOUT_CHECKBOX,
+  LAYOUT_TOGGLE_BUTTON,
+};
+
+#define LAYOUT_NO_ENTITY 0xFF
+#define LAYOUT_NO_STYLE STYLE_NONE
+
+/* One widget, 16 bytes */
+struct lvgl_layout_item_t
+{
+  uint8_t type;   /* lvgl_layout_type_t */
+  uint8_t screen; /* index of the screen the widget lives on */
+  uint8_t style;  /* style id, see LvglStyles.h, LAYOUT_NO_STYLE for the theme only */
+  uint8_t entity; /* layout id of the bound LvglWidget, or LAYOUT_NO_ENTITY */
+  int16_t x;
+  int16_t y;
+  int16_t w; /* 0 sizes the object to its content */
+  int16_t h;
+  const char *text; /* static text, NULL uses the entity name */
+};
+
+struct lvgl_layout_t
+{
+  const lvgl_layout_item_t *items;
+  uint16_t count;
+  uint8_t screens;
+};
+
+// Example, widgets bound with new LvglSwitch(0), new LvglCheckbox(1) and new LvglToggleButton(2):
+//   PROGMEM const lvgl_layout_item_t ui_items[] = {
+//       {LAYOUT_LABEL, 0, LAYOUT_NO_STYLE, LAYOUT_NO_ENTITY, 10, 10, 0, 0, "Living room"},
+//       {LAYOUT_SWITCH, 0, STYLE_SWITCH, 0, 50, 50, 80, 45, NULL},
+//       {LAYOUT_CHECKBOX, 0, LAYOUT_NO_STYLE, 1, 50, 100, 150, 30, NULL},
+//       {LAYOUT_TOGGLE_BUTTON, 0, LAYOUT_NO_STYLE, 2, 50, 200, 150, 45, "Lights"},
+//   };
+//   PROGMEM const lvgl_layout_t ui_layout = {ui_items, sizeof(ui_items) / sizeof(ui_items[0]), 1};
+
+// Creates all widgets of a layout in one pass, after LvglComponent and before the widget components
+class LvglLayoutLoader : public Component
+{
+public:
+  LvglLayoutLoader(const lvgl_layout_t *layout) { this->layout_ = layout; }
+
+  void setup() override
+  {
+    uint32_t start = millis();
+
+    this->screens_.push_back(lv_scr_act());
+    for (uint8_t i = 1; i < this->layout_->screens; i++)
+      this->screens_.push_back(lv_obj_create(NULL));
+
+    // Screen by screen, to measure the lvgl memory each one takes
+    for (uint8_t screen = 0; screen < this->layout_->screens; screen++)
+    {
+      uint32_t used = lvgl_mem_used();
+      for (uint16_t i = 0; i < this->layout_->count; i++)
+        if (this->layout_->items[i].screen == screen)
+          create(this->layout_->items[i]);
+
+      this->screen_mem_.push_back(lvgl_mem_used() - used);
+      ESP_LOGD("lvgl", "Layout screen %u uses %u bytes of lvgl memory", screen, (unsigned)this->screen_mem_.back());
+    }
+
+    ESP_LOGI("lvgl", "Layout with %u widgets on %u screens loaded in %u ms", this->layout_->count,
+             this->layout_->screens, (unsigned)(millis() - start));
+    check_entities();
+  }
+  float get_setup_priority() const override { return esphome::setup_priority::DATA - 0.5f; }
+
+  void show_screen(uint8_t screen)
+  {
+    if (screen < this->screens_.size())
+      lvgl_call(load_screen, this->screens_[screen], 0);
+  }
+
+  // lvgl memory taken by creating the widgets of a screen
+  uint32_t get_screen_mem(uint8_t screen) { return screen < this->screen_mem_.size() ? this->screen_mem_[screen] : 0; }
+
+private:
+  const lvgl_layout_t *layout_;
+
+  static void load_screen(void *screen, int32_t) { lv_scr_load((lv_obj_t *)screen); }
+  std::vector<lv_obj_t *> screens_;
+  std::vector<uint32_t> screen_mem_;
+
+  void create(const lvgl_layout_item_t &item)
+  {
+    if (item.screen >= this->screens_.size())
+      return;
+
+    lv_obj_t *parent = this->screens_[item.screen];
+    LvglWidgetBase *entity = item.entity < LVGL_LAYOUT_MAX_ENTITIES ? LvglWidgetBase::layout_entities()[item.entity] : NULL;
+    if (item.entity != LAYOUT_NO_ENTITY && entity == NULL)
+      ESP_LOGE("lvgl", "Layout item at %d,%d refers to entity %u, no widget has that layout id", item.x, item.y,
+               item.entity);
+    lv_obj_t *obj;
+
+    switch (item.type)
+    {
+    case LAYOUT_LABEL:
+      obj = lv_label_create(parent);
+      set_text(obj, item, entity, lv_label_set_text_static, lv_label_set_text);
+      break;
+
+    case LAYOUT_SWITCH:
+      obj = lv_switch_create(parent);
+      break;
+
+    case LAYOUT_CHECKBOX:
+      obj = lv_checkbox_create(parent);
+      set_text(obj, item, entity, lv_checkbox_set_text_static, lv_checkbox_set_text);
+      break;
+
+    case LAYOUT_TOGGLE_BUTTON:
+    {
+      obj = lv_btn_create(parent);
+      lv_obj_add_flag(obj, LV_OBJ_FLAG_CHECKABLE); // enable toggle
+
+      lv_obj_t *label = lv_label_create(obj);
+      set_text(label, item, entity, lv_label_set_text_static, lv_label_set_text);
+      lv_obj_center(label);
+      break;
+    }
+
+    default:
+      ESP_LOGW("lvgl", "Unknown layout widget type %u", item.type);
+      return;
+    }
+
+    lvgl_styles.apply(obj, item.style);
+
+    lv_obj_set_pos(obj, item.x, item.y);
+    if (item.w > 0 && item.h > 0)
+      lv_obj_set_size(obj, item.w, item.h);
+
+    if (entity != NULL)
+      entity->adopt(obj);
+  }
+
+  /* A typo in the table would otherwise ship as an invisible widget */
+  void check_entities()
+  {
+    for (LvglWidgetBase *widget : LvglWidgetBase::layout_rejected())
+      ESP_LOGE("lvgl", "Widget %s has layout id %u, ids go up to %u (LVGL_LAYOUT_MAX_ENTITIES)",
+               widget->get_name().c_str(), widget->get_layout_id(), LVGL_LAYOUT_MAX_ENTITIES - 1);
+    for (uint8_t id = 0; id < LVGL_LAYOUT_MAX_ENTITIES; id++)
+    {
+      LvglWidgetBase *widget = LvglWidgetBase::layout_entities()[id];
+      if (widget != NULL && widget->get_lv_obj() == NULL)
+        ESP_LOGE("lvgl", "Widget %s has layout id %u but no layout item, it is created with size 0x0 at 0,0",
+                 widget->get_name().c_str(), id);
+    }
+  }
+
+  // Flash text is referenced, only entity names are copied
+  static void set_text(lv_obj_t *obj, const lvgl_layout_item_t &item, LvglWidgetBase *entity,
+                       void (*set_static)(lv_obj_t *, const char *), void (*set_copy)(lv_obj_t *, const char *))
+  {
+    if (item.text != NULL)
+      set_static(obj, item.text);
+    else if (entity != NULL)
+      set_copy(obj, entity->get_name().c_str());
+  }
+};
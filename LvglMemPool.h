@@ -0,0 +1,491 @@
+#pragma once
+
+// Fragmentation resistant allocator for lvgl, enabled with -D LVGL_USE_MEM_POOL (see lv_conf.h)
+//
+// - Small blocks (lv_obj parts, styles, short label texts) come from size-class slabs. A page of
+//   a slab only ever holds blocks of one size, so churn of small blocks cannot fragment the pool.
+// - Larger blocks come from a TLSF pool: two-level segregated free lists, constant time
+//   alloc and free, immediate coalescing of neighbours.
+// - With LVGL_POOL_OVERFLOW, allocations that do not fit spill over to PSRAM (or the system heap).
+// - With LVGL_MEM_TRACE, every allocation is logged as a trace line for LvglMemPoolBenchmark.
+
+#ifdef LVGL_USE_MEM_POOL
+
+#include <stdint.h>
+#include <string.h>
+#include "lvgl.h"
+#include "lv_mem_pool.h"
+#if defined(LVGL_POOL_OVERFLOW) && defined(ARDUINO_ARCH_ESP32)
+#include "esp_heap_caps.h"
+#endif
+#ifdef LVGL_MEM_TRACE
+#include "esphome.h"
+#endif
+
+#ifndef LVGL_POOL_SIZE
+#ifdef LV_MEM_SIZE
+#define LVGL_POOL_SIZE LV_MEM_SIZE
+#else
+#define LVGL_POOL_SIZE (48 * 1024U)
+#endif
+#endif
+#ifndef LVGL_POOL_SLAB_SIZE
+#define LVGL_POOL_SLAB_SIZE (LVGL_POOL_SIZE / 4) /* part of the pool reserved for slab pages */
+#endif
+#define LVGL_POOL_PAGE 256 /* bytes per slab page */
+
+/* Size classes of the slabs, the largest one is the limit for slab allocations */
+static const uint16_t pool_classes[] = {8, 16, 24, 32, 48, 64, 96, 128};
+#define POOL_CLASSES (sizeof(pool_classes) / sizeof(pool_classes[0]))
+#define POOL_SLAB_PAGES (LVGL_POOL_SLAB_SIZE / LVGL_POOL_PAGE)
+#define POOL_NO_CLASS 0xFF
+
+/* TLSF parameters */
+#define TLSF_ALIGN 8
+#define TLSF_SL_LOG2 4 /* 16 second level lists per first level */
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_FL_SHIFT (TLSF_SL_LOG2 + 3) /* sizes below 128 bytes share the first list */
+#define TLSF_SMALL (1 << TLSF_FL_SHIFT)
+#define TLSF_FL_COUNT (24 - TLSF_FL_SHIFT + 1) /* blocks up to 16 MB */
+#define TLSF_FREE 1                           /* flag in the size field */
+
+struct tlsf_block_t
+{
+  tlsf_block_t *prev_phys; /* block before this one in memory, NULL for the first */
+  size_t size;             /* payload size, TLSF_FREE flag in bit 0 */
+  /* payload, while free it holds the free list links */
+  tlsf_block_t *next_free;
+  tlsf_block_t *prev_free;
+};
+#define TLSF_HEADER (2 * sizeof(void *))
+#define TLSF_MIN_SIZE (2 * sizeof(void *))
+
+/* Statistics, read by lvgl_mem_monitor() */
+struct mem_pool_stats_t
+{
+  uint32_t used;          /* bytes handed out, including slab and TLSF overhead */
+  uint32_t max_used;      /* peak of used */
+  uint32_t used_cnt;      /* live allocations */
+  uint32_t slab_allocs;   /* allocations served by a slab */
+  uint32_t tlsf_allocs;   /* allocations served by the TLSF pool */
+  uint32_t overflow_allocs; /* allocations that spilled over */
+  uint32_t failed;        /* allocations that returned NULL */
+};
+
+static struct
+{
+  alignas(TLSF_ALIGN) uint8_t arena[LVGL_POOL_SIZE];
+  bool ready;
+
+  uint8_t *slab_end;
+  uint16_t slab_pages_used;
+  uint8_t page_class[POOL_SLAB_PAGES];
+  void *slab_free[POOL_CLASSES];
+  uint16_t slab_free_cnt[POOL_CLASSES];
+
+  uint8_t *tlsf_start;
+  uint8_t *tlsf_end;
+  uint32_t fl_bitmap;
+  uint32_t sl_bitmap[TLSF_FL_COUNT];
+  tlsf_block_t *blocks[TLSF_FL_COUNT][TLSF_SL_COUNT];
+  uint32_t tlsf_free;
+  uint32_t tlsf_free_cnt;
+
+  mem_pool_stats_t stats;
+} mem_pool;
+
+static inline int pool_fls(size_t v) { return v ? (int)(sizeof(unsigned long) * 8 - 1 - __builtin_clzl(v)) : -1; }
+static inline int pool_ffs(uint32_t v) { return __builtin_ffs(v) - 1; }
+
+static inline tlsf_block_t *tlsf_next_phys(tlsf_block_t *b)
+{
+  return (tlsf_block_t *)((uint8_t *)b + TLSF_HEADER + (b->size & ~(size_t)TLSF_FREE));
+}
+static inline void *tlsf_payload(tlsf_block_t *b) { return (uint8_t *)b + TLSF_HEADER; }
+static inline tlsf_block_t *tlsf_from_payload(void *p) { return (tlsf_block_t *)((uint8_t *)p - TLSF_HEADER); }
+
+static void tlsf_mapping(size_t size, int *fl, int *sl)
+{
+  if (size < TLSF_SMALL)
+  {
+    *fl = 0;
+    *sl = (int)size / (TLSF_SMALL / TLSF_SL_COUNT);
+  }
+  else
+  {
+    int f = pool_fls(size);
+    *sl = (int)(size >> (f - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+    *fl = f - (TLSF_FL_SHIFT - 1);
+  }
+}
+
+static void tlsf_insert(tlsf_block_t *b)
+{
+  int fl, sl;
+  tlsf_mapping(b->size & ~(size_t)TLSF_FREE, &fl, &sl);
+  b->size |= TLSF_FREE;
+  b->prev_free = NULL;
+  b->next_free = mem_pool.blocks[fl][sl];
+  if (b->next_free)
+    b->next_free->prev_free = b;
+  mem_pool.blocks[fl][sl] = b;
+  mem_pool.fl_bitmap |= 1U << fl;
+  mem_pool.sl_bitmap[fl] |= 1U << sl;
+  mem_pool.tlsf_free += b->size & ~(size_t)TLSF_FREE;
+  mem_pool.tlsf_free_cnt++;
+}
+
+static void tlsf_remove(tlsf_block_t *b)
+{
+  int fl, sl;
+  tlsf_mapping(b->size & ~(size_t)TLSF_FREE, &fl, &sl);
+  if (b->prev_free)
+    b->prev_free->next_free = b->next_free;
+  else
+    mem_pool.blocks[fl][sl] = b->next_free;
+  if (b->next_free)
+    b->next_free->prev_free = b->prev_free;
+
+  if (mem_pool.blocks[fl][sl] == NULL)
+  {
+    mem_pool.sl_bitmap[fl] &= ~(1U << sl);
+    if (mem_pool.sl_bitmap[fl] == 0)
+      mem_pool.fl_bitmap &= ~(1U << fl);
+  }
+  b->size &= ~(size_t)TLSF_FREE;
+  mem_pool.tlsf_free -= b->size;
+  mem_pool.tlsf_free_cnt--;
+}
+
+/* First free block of a list that is guaranteed to hold size bytes */
+static tlsf_block_t *tlsf_search(size_t size)
+{
+  if (size >= TLSF_SMALL)
+    size += ((size_t)1 << (pool_fls(size) - TLSF_SL_LOG2)) - 1; /* round up to the next list */
+
+  int fl, sl;
+  tlsf_mapping(size, &fl, &sl);
+  if (fl >= TLSF_FL_COUNT)
+    return NULL;
+
+  uint32_t sl_map = mem_pool.sl_bitmap[fl] & (~0U << sl);
+  if (sl_map == 0)
+  {
+    uint32_t fl_map = fl + 1 < 32 ? mem_pool.fl_bitmap & (~0U << (fl + 1)) : 0;
+    if (fl_map == 0)
+      return NULL;
+    fl = pool_ffs(fl_map);
+    sl_map = mem_pool.sl_bitmap[fl];
+  }
+  return mem_pool.blocks[fl][pool_ffs(sl_map)];
+}
+
+static void *tlsf_alloc(size_t size)
+{
+  size = (size + TLSF_ALIGN - 1) & ~(size_t)(TLSF_ALIGN - 1);
+  if (size < TLSF_MIN_SIZE)
+    size = TLSF_MIN_SIZE;
+
+  tlsf_block_t *b = tlsf_search(size);
+  if (b == NULL)
+    return NULL;
+  tlsf_remove(b);
+
+  /* Return the tail as a new free block when it is big enough */
+  if (b->size >= size + TLSF_HEADER + TLSF_MIN_SIZE)
+  {
+    tlsf_block_t *rest = (tlsf_block_t *)((uint8_t *)tlsf_payload(b) + size);
+    rest->size = b->size - size - TLSF_HEADER;
+    rest->prev_phys = b;
+    tlsf_next_phys(rest)->prev_phys = rest;
+    b->size = size;
+    tlsf_insert(rest);
+  }
+  return tlsf_payload(b);
+}
+
+static void tlsf_free(void *p)
+{
+  tlsf_block_t *b = tlsf_from_payload(p);
+
+  tlsf_block_t *prev = b->prev_phys;
+  if (prev != NULL && (prev->size & TLSF_FREE))
+  {
+    tlsf_remove(prev);
+    prev->size += TLSF_HEADER + b->size;
+    tlsf_next_phys(prev)->prev_phys = prev;
+    b = prev;
+  }
+
+  tlsf_block_t *next = tlsf_next_phys(b);
+  if (next->size & TLSF_FREE)
+  {
+    tlsf_remove(next);
+    b->size += TLSF_HEADER + next->size;
+    tlsf_next_phys(b)->prev_phys = b;
+  }
+
+  tlsf_insert(b);
+}
+
+static void mem_pool_init()
+{
+  memset(&mem_pool.page_class, POOL_NO_CLASS, sizeof(mem_pool.page_class));
+  mem_pool.slab_end = mem_pool.arena + POOL_SLAB_PAGES * LVGL_POOL_PAGE;
+
+  /* The rest of the arena is one free TLSF block followed by a used sentinel of size 0 */
+  mem_pool.tlsf_start = mem_pool.slab_end;
+  mem_pool.tlsf_end = mem_pool.arena + (sizeof(mem_pool.arena) & ~(size_t)(TLSF_ALIGN - 1));
+  tlsf_block_t *b = (tlsf_block_t *)mem_pool.tlsf_start;
+  b->prev_phys = NULL;
+  b->size = mem_pool.tlsf_end - mem_pool.tlsf_start - 2 * TLSF_HEADER;
+  tlsf_block_t *sentinel = tlsf_next_phys(b);
+  sentinel->prev_phys = b;
+  sentinel->size = 0;
+  tlsf_insert(b);
+
+  mem_pool.ready = true;
+}
+
+static int8_t slab_class(size_t size)
+{
+  for (uint8_t c = 0; c < POOL_CLASSES; c++)
+    if (size <= pool_classes[c])
+      return c;
+  return -1;
+}
+
+static void *slab_alloc(uint8_t c)
+{
+  if (mem_pool.slab_free[c] == NULL)
+  {
+    /* Carve a fresh page into blocks of this class */
+    if (mem_pool.slab_pages_used >= POOL_SLAB_PAGES)
+      return NULL;
+    uint16_t page = mem_pool.slab_pages_used++;
+    mem_pool.page_class[page] = c;
+    uint8_t *base = mem_pool.arena + page * LVGL_POOL_PAGE;
+    for (uint16_t off = 0; off + pool_classes[c] <= LVGL_POOL_PAGE; off += pool_classes[c])
+    {
+      *(void **)(base + off) = mem_pool.slab_free[c];
+      mem_pool.slab_free[c] = base + off;
+      mem_pool.slab_free_cnt[c]++;
+    }
+  }
+
+  void *p = mem_pool.slab_free[c];
+  mem_pool.slab_free[c] = *(void **)p;
+  mem_pool.slab_free_cnt[c]--;
+  return p;
+}
+
+#ifdef LVGL_POOL_OVERFLOW
+/* Overflow blocks carry their size in front of the payload, for realloc */
+static void *overflow_alloc(size_t size)
+{
+#ifdef ARDUINO_ARCH_ESP32
+  size_t *p = (size_t *)heap_caps_malloc(size + TLSF_ALIGN, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (p == NULL)
+    p = (size_t *)heap_caps_malloc(size + TLSF_ALIGN, MALLOC_CAP_8BIT);
+#else
+  size_t *p = (size_t *)malloc(size + TLSF_ALIGN);
+#endif
+  if (p == NULL)
+    return NULL;
+  *p = size;
+  return (uint8_t *)p + TLSF_ALIGN;
+}
+
+static void overflow_free(void *p)
+{
+#ifdef ARDUINO_ARCH_ESP32
+  heap_caps_free((uint8_t *)p - TLSF_ALIGN);
+#else
+  free((uint8_t *)p - TLSF_ALIGN);
+#endif
+}
+#endif
+
+/* Usable size of a block handed out by the pool */
+static size_t mem_pool_size(void *p)
+{
+  uint8_t *b = (uint8_t *)p;
+  if (b >= mem_pool.arena && b < mem_pool.slab_end)
+    return pool_classes[mem_pool.page_class[(b - mem_pool.arena) / LVGL_POOL_PAGE]];
+  if (b >= mem_pool.tlsf_start && b < mem_pool.tlsf_end)
+    return tlsf_from_payload(p)->size;
+  return *(size_t *)(b - TLSF_ALIGN);
+}
+
+static void mem_pool_account(void *p, int8_t sign)
+{
+  uint8_t *b = (uint8_t *)p;
+  uint32_t size = mem_pool_size(p);
+  if (b >= mem_pool.tlsf_start && b < mem_pool.tlsf_end)
+    size += TLSF_HEADER;
+
+  mem_pool.stats.used += sign * (int32_t)size;
+  mem_pool.stats.used_cnt += sign;
+  if (mem_pool.stats.used > mem_pool.stats.max_used)
+    mem_pool.stats.max_used = mem_pool.stats.used;
+}
+
+#ifdef LVGL_MEM_TRACE
+#ifndef LVGL_MEM_TRACE_SLOTS
+#define LVGL_MEM_TRACE_SLOTS 512 /* blocks of a trace alive at the same time */
+#endif
+/* Blocks are logged by slot instead of address, so a replay can map them to its own pointers */
+static void *mem_trace_slots[LVGL_MEM_TRACE_SLOTS];
+static bool mem_trace_realloc = false; /* the alloc and free of a moving realloc are logged as one 'r' */
+
+/* op 'a' alloc, 'f' free, 'r' realloc from old to p */
+static void mem_trace(char op, void *p, size_t size, void *old = NULL)
+{
+  if (mem_trace_realloc)
+    return;
+  uint16_t slot = 0;
+  void *find = op == 'a' ? NULL : op == 'r' ? old : p;
+  while (slot < LVGL_MEM_TRACE_SLOTS && mem_trace_slots[slot] != find)
+    slot++;
+  if (slot == LVGL_MEM_TRACE_SLOTS)
+    return; // not traced, or no free slot
+  mem_trace_slots[slot] = op == 'f' ? NULL : p;
+  ESP_LOGD("lvgl.trace", "{'%c', %u, %u},", op, slot, (unsigned)(op == 'f' ? 0 : size));
+}
+#endif
+
+extern "C" void *lv_mem_pool_alloc(size_t size)
+{
+  if (!mem_pool.ready)
+    mem_pool_init();
+  if (size == 0)
+    return NULL;
+
+  void *p = NULL;
+  int8_t c = slab_class(size);
+  if (c >= 0 && (p = slab_alloc(c)) != NULL)
+    mem_pool.stats.slab_allocs++;
+  else if ((p = tlsf_alloc(size)) != NULL)
+    mem_pool.stats.tlsf_allocs++;
+#ifdef LVGL_POOL_OVERFLOW
+  else if ((p = overflow_alloc(size)) != NULL)
+    mem_pool.stats.overflow_allocs++;
+#endif
+
+  if (p == NULL)
+  {
+    mem_pool.stats.failed++;
+    return NULL;
+  }
+  mem_pool_account(p, 1);
+#ifdef LVGL_MEM_TRACE
+  mem_trace('a', p, size);
+#endif
+  return p;
+}
+
+extern "C" void lv_mem_pool_free(void *p)
+{
+  if (p == NULL)
+    return;
+  mem_pool_account(p, -1);
+#ifdef LVGL_MEM_TRACE
+  mem_trace('f', p, 0);
+#endif
+
+  uint8_t *b = (uint8_t *)p;
+  if (b >= mem_pool.arena && b < mem_pool.slab_end)
+  {
+    uint8_t c = mem_pool.page_class[(b - mem_pool.arena) / LVGL_POOL_PAGE];
+    *(void **)p = mem_pool.slab_free[c];
+    mem_pool.slab_free[c] = p;
+    mem_pool.slab_free_cnt[c]++;
+  }
+  else if (b >= mem_pool.tlsf_start && b < mem_pool.tlsf_end)
+    tlsf_free(p);
+#ifdef LVGL_POOL_OVERFLOW
+  else
+    overflow_free(p);
+#endif
+}
+
+extern "C" void *lv_mem_pool_realloc(void *p, size_t size)
+{
+  if (p == NULL)
+    return lv_mem_pool_alloc(size);
+  if (size == 0)
+  {
+    lv_mem_pool_free(p);
+    return NULL;
+  }
+
+  size_t old = mem_pool_size(p);
+  if (size <= old && size * 2 > old)
+  {
+#ifdef LVGL_MEM_TRACE
+    mem_trace('r', p, size, p);
+#endif
+    return p; /* fits and does not waste half of the block */
+  }
+
+#ifdef LVGL_MEM_TRACE
+  mem_trace_realloc = true;
+#endif
+  void *n = lv_mem_pool_alloc(size);
+  if (n != NULL)
+  {
+    memcpy(n, p, size < old ? size : old);
+    lv_mem_pool_free(p);
+  }
+#ifdef LVGL_MEM_TRACE
+  mem_trace_realloc = false;
+  if (n != NULL)
+    mem_trace('r', n, size, p);
+#endif
+  return n;
+}
+
+/* Bytes of the slab reservation not in use, for small blocks only */
+static uint32_t lv_mem_pool_slab_free()
+{
+  uint32_t slab_free = (POOL_SLAB_PAGES - mem_pool.slab_pages_used) * LVGL_POOL_PAGE;
+  for (uint8_t c = 0; c < POOL_CLASSES; c++)
+    slab_free += mem_pool.slab_free_cnt[c] * pool_classes[c];
+  return slab_free;
+}
+
+/* Same figures as the built-in allocator reports, for the memory sensors. Free memory is what any
+   allocation can use, the TLSF part of the pool. */
+static void lv_mem_pool_monitor(lv_mem_monitor_t *mon)
+{
+  if (!mem_pool.ready)
+    mem_pool_init();
+  memset(mon, 0, sizeof(*mon));
+
+  uint32_t slab_free_cnt = 0;
+  for (uint8_t c = 0; c < POOL_CLASSES; c++)
+    slab_free_cnt += mem_pool.slab_free_cnt[c];
+
+  /* Biggest block in the highest non-empty list */
+  uint32_t biggest = 0;
+  if (mem_pool.fl_bitmap)
+  {
+    int fl = pool_fls(mem_pool.fl_bitmap);
+    int sl = pool_fls(mem_pool.sl_bitmap[fl]);
+    for (tlsf_block_t *b = mem_pool.blocks[fl][sl]; b != NULL; b = b->next_free)
+      if ((b->size & ~(size_t)TLSF_FREE) > biggest)
+        biggest = b->size & ~(size_t)TLSF_FREE;
+  }
+
+  mon->total_size = sizeof(mem_pool.arena);
+  // Slab space only takes blocks of up to 128 bytes and never goes back to TLSF, it is reported apart
+  mon->free_size = mem_pool.tlsf_free;
+  mon->free_biggest_size = biggest;
+  mon->free_cnt = mem_pool.tlsf_free_cnt + slab_free_cnt;
+  mon->used_cnt = mem_pool.stats.used_cnt;
+  mon->max_used = mem_pool.stats.max_used;
+  mon->used_pct = 100 - (100U * mon->free_size) / mon->total_size;
+  mon->frag_pct = mem_pool.tlsf_free ? 100 - (100U * biggest) / mem_pool.tlsf_free : 0;
+}
+
+#endif
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <vector>
+#include "esphome.h"
+#include "lvgl.h"
+#include "LvglComponent.h"
+#ifndef ARDUINO_ARCH_ESP32
+#include <chrono>
+#endif
+
+// Replays an lvgl allocation trace through lv_mem_alloc/lv_mem_realloc/lv_mem_free and logs one JSON line:
+// {"case":"mem_trace","allocator":"pool","trace":"synthetic","ops":5314,"failed":0,"alloc_ns":310,...}
+// The allocator is the one the build uses, run it in two host builds, with and without -D LVGL_USE_MEM_POOL,
+// to compare the pool with lvgl's built-in heap (LV_MEM_CUSTOM 1 and 0) on the same trace.
+//
+// Without a trace of your own, a synthetic one is generated: widgets created and deleted in groups, as pages
+// do, label texts set again and again with varying lengths, and a few short-lived large buffers.
+// A recorded trace comes from a build with -D LVGL_USE_MEM_POOL -D LVGL_MEM_TRACE, which logs every lvgl
+// allocation as a mem_trace_op_t initializer under "lvgl.trace". Paste the lines into an array and pass it:
+//   static const mem_trace_op_t my_trace[] = { {'a', 0, 52}, {'a', 1, 12}, {'r', 1, 30}, {'f', 0, 0}, ... };
+//   auto mem_benchmark = new LvglMemPoolBenchmark(my_trace, sizeof(my_trace) / sizeof(my_trace[0]));
+
+#ifndef LVGL_MEM_TRACE_SLOTS
+#define LVGL_MEM_TRACE_SLOTS 512 /* blocks of a trace alive at the same time */
+#endif
+
+/* One allocator call, blocks are named by slot: the pointer the replay got for that slot is used */
+struct mem_trace_op_t
+{
+  char op;       /* 'a' alloc, 'r' realloc, 'f' free */
+  uint16_t slot; /* < LVGL_MEM_TRACE_SLOTS */
+  uint32_t size; /* bytes, unused for free */
+};
+
+class LvglMemPoolBenchmark : public Component
+{
+public:
+  LvglMemPoolBenchmark(const mem_trace_op_t *trace = NULL, uint32_t count = 0) : trace_(trace), count_(count) {}
+
+  void loop() override
+  {
+    // Run once, after all widgets have been set up
+    if (this->done_)
+      return;
+    this->done_ = true;
+    lvgl_call(run_cb, this, 0); // in the render task when lvgl has one, the lvgl heap is not thread safe
+  }
+  float get_setup_priority() const override { return esphome::setup_priority::LATE; }
+
+  void run()
+  {
+    std::vector<mem_trace_op_t> synthetic;
+    const mem_trace_op_t *trace = this->trace_;
+    uint32_t count = this->count_;
+    if (trace == NULL)
+    {
+      generate(synthetic);
+      trace = synthetic.data();
+      count = synthetic.size();
+    }
+
+    void **blocks = (void **)calloc(LVGL_MEM_TRACE_SLOTS, sizeof(void *)); // not from the heap being measured
+    if (blocks == NULL)
+      return;
+    lv_mem_monitor_t before;
+    lvgl_mem_read(&before);
+
+    Latency alloc, realloc, release;
+    uint32_t failed = 0, peak = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+      const mem_trace_op_t &op = trace[i];
+      if (op.slot >= LVGL_MEM_TRACE_SLOTS)
+        continue;
+      void *&p = blocks[op.slot];
+      uint32_t t = ticks();
+      switch (op.op)
+      {
+      case 'a':
+        if (p != NULL)
+          continue; // slot still in use, the trace lost a free
+        p = lv_mem_alloc(op.size);
+        alloc.add(ticks() - t);
+        failed += p == NULL;
+        break;
+      case 'r':
+      {
+        void *n = lv_mem_realloc(p, op.size);
+        realloc.add(ticks() - t);
+        if (n == NULL)
+          failed++;
+        else
+          p = n;
+        break;
+      }
+      case 'f':
+        if (p == NULL)
+          continue;
+        lv_mem_free(p);
+        release.add(ticks() - t);
+        p = NULL;
+        break;
+      }
+
+      if ((i & 63) == 0)
+      {
+        lv_mem_monitor_t mon;
+        lvgl_mem_read(&mon);
+        if (mon.free_size < before.free_size)
+          peak = LV_MAX(peak, before.free_size - mon.free_size);
+      }
+    }
+
+    // Fragmentation with the blocks the trace left alive, e.g. the widgets of the last page
+    lv_mem_monitor_t after;
+    lvgl_mem_read(&after);
+    uint32_t live = 0;
+    for (uint16_t s = 0; s < LVGL_MEM_TRACE_SLOTS; s++)
+      if (blocks[s] != NULL)
+      {
+        lv_mem_free(blocks[s]);
+        live++;
+      }
+    free(blocks);
+
+#ifdef LVGL_USE_MEM_POOL
+    const char *allocator = "pool";
+#else
+    const char *allocator = "builtin";
+#endif
+    ESP_LOGI("lvgl.bench",
+             "{\"case\":\"mem_trace\",\"allocator\":\"%s\",\"trace\":\"%s\",\"ops\":%u,\"failed\":%u,"
+             "\"alloc_ns\":%.0f,\"alloc_max_ns\":%.0f,\"realloc_ns\":%.0f,\"realloc_max_ns\":%.0f,"
+             "\"free_ns\":%.0f,\"free_max_ns\":%.0f,\"peak_bytes\":%u,\"live_blocks\":%u,\"free_bytes\":%u,"
+             "\"biggest_free\":%u,\"frag_pct\":%u}",
+             allocator, this->trace_ != NULL ? "recorded" : "synthetic", (unsigned)count, (unsigned)failed,
+             alloc.mean_ns(), alloc.max_ns(), realloc.mean_ns(), realloc.max_ns(), release.mean_ns(), release.max_ns(),
+             (unsigned)peak, (unsigned)live, (unsigned)after.free_size, (unsigned)after.free_biggest_size,
+             (unsigned)after.frag_pct);
+  }
+
+private:
+  const mem_trace_op_t *trace_;
+  uint32_t count_;
+  bool done_ = false;
+
+  static void run_cb(void *self, int32_t) { ((LvglMemPoolBenchmark *)self)->run(); }
+
+  // Fine enough for a single allocation: CPU cycles on the ESP32, nanoseconds on the host
+  static uint32_t ticks()
+  {
+#ifdef ARDUINO_ARCH_ESP32
+    return ESP.getCycleCount();
+#else
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+  static float to_ns(float ticks)
+  {
+#ifdef ARDUINO_ARCH_ESP32
+    return ticks * 1000.0f / ESP.getCpuFreqMHz();
+#else
+    return ticks;
+#endif
+  }
+
+  struct Latency
+  {
+    uint32_t count = 0;
+    uint64_t total = 0;
+    uint32_t max = 0;
+    void add(uint32_t t)
+    {
+      this->count++;
+      this->total += t;
+      this->max = LV_MAX(this->max, t);
+    }
+    float mean_ns() { return this->count ? to_ns((float)this->total / this->count) : 0; }
+    float max_ns() { return to_ns(this->max); }
+  };
+
+  /* Widgets of 16 pages built and deleted in turn, with label texts changing in between */
+  static void generate(std::vector<mem_trace_op_t> &trace)
+  {
+    const uint16_t page_slots = 96; // 32 widgets of three blocks: object, attributes, text
+    uint32_t seed = 12345;
+    auto rnd = [&seed](uint16_t n) {
+      seed = seed * 1103515245 + 12345;
+      return (uint16_t)((seed >> 16) % n);
+    };
+
+    for (uint8_t page = 0; page < 16; page++)
+    {
+      uint16_t base = (page & 1) * page_slots; // two pages alive while switching
+      for (uint16_t w = 0; w < page_slots / 3; w++)
+      {
+        trace.push_back({'a', (uint16_t)(base + 3 * w), (uint16_t)(48 + rnd(5) * 8)});     // lv_obj and its class data
+        trace.push_back({'a', (uint16_t)(base + 3 * w + 1), (uint16_t)(24 + rnd(4) * 8)}); // spec_attr, styles
+        trace.push_back({'a', (uint16_t)(base + 3 * w + 2), (uint16_t)(4 + rnd(28))});     // label text
+      }
+      // The previous page goes once the new one is shown
+      if (page > 0)
+        for (uint16_t s = 0; s < page_slots; s++)
+          trace.push_back({'f', (uint16_t)((page_slots - base) + s), 0});
+
+      // Sensor values arriving while the page is shown
+      for (uint16_t i = 0; i < 250; i++)
+      {
+        trace.push_back({'r', (uint16_t)(base + 3 * rnd(page_slots / 3) + 2), (uint16_t)(4 + rnd(60))});
+        if (rnd(50) == 0)
+        {
+          // A short-lived large buffer, e.g. a decoded image or a snapshot
+          trace.push_back({'a', (uint16_t)(2 * page_slots), (uint16_t)(1024 + rnd(3072))});
+          trace.push_back({'f', (uint16_t)(2 * page_slots), 0});
+        }
+      }
+    }
+  }
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "esphome.h"
+#include "lvgl.h"
+#include "LvglComponent.h"
+
+#ifndef LVGL_MEM_LOW_WATER
+#define LVGL_MEM_LOW_WATER 4096 /* [bytes] free lvgl memory below which the low memory alarm is raised */
+#endif
+
+#ifdef USE_SENSOR // Sensor only exists when the yaml has a sensor: component
+// Samples the lvgl heap and publishes its usage
+class LvglMemorySensor : public PollingComponent
+{
+public:
+  Sensor *total_sensor = new Sensor();
+  Sensor *free_sensor = new Sensor();
+  Sensor *max_used_sensor = new Sensor();      // peak use since boot
+  Sensor *biggest_free_sensor = new Sensor();  // largest allocation that can still succeed
+  Sensor *fragmentation_sensor = new Sensor(); // percent
+  Sensor *min_free_sensor = new Sensor();      // low water mark since boot
+#ifdef USE_BINARY_SENSOR
+  BinarySensor *low_memory_sensor = new BinarySensor();
+#endif
+
+  LvglMemorySensor(uint32_t update_interval = 10000) : PollingComponent(update_interval) {}
+
+  void set_low_water(uint32_t bytes) { this->low_water_ = bytes; }
+
+  void update() override
+  {
+    lv_mem_monitor_t mon;
+    lvgl_mem_monitor(&mon);
+
+    if (mon.free_size < this->min_free_)
+      this->min_free_ = mon.free_size;
+
+    total_sensor->publish_state(mon.total_size);
+    free_sensor->publish_state(mon.free_size);
+    max_used_sensor->publish_state(mon.max_used);
+    biggest_free_sensor->publish_state(mon.free_biggest_size);
+    fragmentation_sensor->publish_state(mon.frag_pct);
+    min_free_sensor->publish_state(this->min_free_);
+
+    // Alarm on either too little memory or too fragmented to allocate a typical label
+    bool low = mon.free_size < this->low_water_ || mon.free_biggest_size < this->low_water_ / 4;
+    if (low && !this->low_)
+      ESP_LOGW("lvgl.mem", "Low lvgl memory: %u bytes free, biggest block %u, %u%% fragmented", (unsigned)mon.free_size,
+               (unsigned)mon.free_biggest_size, mon.frag_pct);
+#ifdef USE_BINARY_SENSOR
+    if (low != this->low_ || !this->published_)
+      low_memory_sensor->publish_state(low);
+#endif
+    this->low_ = low;
+    this->published_ = true;
+
+    ESP_LOGD("lvgl.mem", "%u of %u bytes used (%u%%), peak %u, biggest free %u, %u%% fragmented",
+             (unsigned)(mon.total_size - mon.free_size), (unsigned)mon.total_size, mon.used_pct, (unsigned)mon.max_used,
+             (unsigned)mon.free_biggest_size, mon.frag_pct);
+  }
+  float get_setup_priority() const override { return esphome::setup_priority::LATE; }
+
+private:
+  uint32_t low_water_ = LVGL_MEM_LOW_WATER;
+  uint32_t min_free_ = UINT32_MAX;
+  bool low_ = false;
+  bool published_ = false;
+};
+
+// The sensors and the binary sensor are declared in different yaml lambdas, both get the same component
+LvglMemorySensor *lvgl_memory_sensor()
+{
+  static LvglMemorySensor *sensor = NULL;
+  if (sensor == NULL)
+  {
+    sensor = new LvglMemorySensor();
+    App.register_component(sensor);
+  }
+  return sensor;
+}
+#endif
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include "esphome.h"
+#include "lvgl.h"
+#include "LvglComponent.h"
+#include "LvglWidget.h"
+
+#ifndef LVGL_PAGES_MAX
+#define LVGL_PAGES_MAX 8 /* pages, including page 0 */
+#endif
+#ifndef LVGL_PAGE_PRELOAD_MS
+#define LVGL_PAGE_PRELOAD_MS 2000 /* [ms] without input before the next page is built in advance */
+#endif
+
+/* Screens whose objects only exist while they are needed.
+   Page 0 is the screen lvgl starts with, it is always built. The other pages are built the first
+   time they are shown, from the widgets set_page() put on them and an optional builder. Pages that
+   are not shown are deleted, least recently shown first, while lvgl uses more memory than the budget.
+   The widgets stay registered entities, their state is applied again when the page is rebuilt.
+   With preload, the page after the current one is built while nothing is drawn and nobody touches
+   the screen, if its memory from an earlier build fits the budget. */
+class LvglPageManager : public Component
+{
+public:
+  struct Stats
+  {
+    uint32_t builds;    /* pages built, on show or preloaded */
+    uint32_t evictions; /* pages deleted to stay within the budget */
+    uint32_t preloads;  /* builds done in idle time */
+  } stats = {};
+
+  // Objects of a page that are not widget entities, e.g. labels, created on screen when the page is built
+  void set_builder(uint8_t page, std::function<void(lv_obj_t *screen)> &&builder)
+  {
+    if (page < LVGL_PAGES_MAX)
+      this->pages_[page].builder = std::move(builder);
+  }
+  // lvgl memory the built pages may use, 0 = three quarters of the lvgl heap
+  void set_mem_budget(uint32_t bytes) { this->budget_ = bytes; }
+  // Build the next page in idle time. Set before setup.
+  void set_preload(bool preload) { this->preload_ = preload; }
+
+  void setup() override
+  {
+    for (LvglObjectBase *widget : LvglObjectBase::paged_widgets())
+      this->count_ = LV_MAX(this->count_, LV_MIN(widget->get_page() + 1, LVGL_PAGES_MAX));
+    for (uint8_t i = 0; i < LVGL_PAGES_MAX; i++)
+      if (this->pages_[i].builder)
+        this->count_ = LV_MAX(this->count_, i + 1);
+
+    if (this->budget_ == 0)
+    {
+      lv_mem_monitor_t mon;
+      lvgl_mem_monitor(&mon);
+      this->budget_ = mon.total_size / 4 * 3;
+    }
+
+    // Page 0 is the default screen, its widgets have been created on it already
+    uint32_t used = lvgl_mem_used();
+    this->pages_[0].screen = lv_scr_act();
+    if (this->pages_[0].builder)
+      this->pages_[0].builder(this->pages_[0].screen);
+    this->pages_[0].mem = lvgl_mem_used() - used;
+    // Without preloading there is nothing to do in idle time, no timer to wake lv_timer_handler
+    if (this->preload_ && this->count_ > 1)
+      this->timer_ = lv_timer_create(idle_cb, LVGL_PAGE_PRELOAD_MS / 4, this);
+    ESP_LOGD("lvgl", "%u pages, %u bytes of lvgl memory for built pages", this->count_, (unsigned)this->budget_);
+  }
+  // After the widgets, which create the objects of page 0
+  float get_setup_priority() const override { return esphome::setup_priority::DATA - 2.0f; }
+
+  /* Build the page if needed and load it, from the render task when lvgl has one */
+  void show_page(uint8_t page) { lvgl_call(show_cb, this, page); }
+  // The page is counted from the one shown when the call is applied, not when it is made
+  void next_page() { lvgl_call(turn_cb, this, 1); }
+  void prev_page() { lvgl_call(turn_cb, this, -1); }
+
+  uint8_t get_page() { return this->current_; }
+  uint8_t get_page_count() { return this->count_; }
+
+private:
+  struct Page
+  {
+    lv_obj_t *screen = NULL;
+    uint32_t mem = 0;        /* lvgl memory of the last build */
+    uint32_t last_shown = 0; /* millis() */
+    std::function<void(lv_obj_t *screen)> builder;
+  };
+  Page pages_[LVGL_PAGES_MAX];
+  uint8_t count_ = 1;
+  std::atomic<uint8_t> current_{0}; /* written by the lvgl thread, read by the main loop */
+  uint32_t budget_ = 0;
+  bool preload_ = false;
+  lv_timer_t *timer_ = NULL;
+
+  static void show_cb(void *self, int32_t page) { ((LvglPageManager *)self)->show((uint8_t)page); }
+  static void turn_cb(void *self, int32_t delta)
+  {
+    LvglPageManager *pages = (LvglPageManager *)self;
+    pages->show((pages->current_ + pages->count_ + delta) % pages->count_);
+  }
+
+  void show(uint8_t page)
+  {
+    if (page >= this->count_ || page == this->current_)
+      return;
+
+    Page &p = this->pages_[page];
+    if (p.screen == NULL)
+    {
+      make_room(p.mem, page);
+      build(page);
+    }
+    lv_scr_load(p.screen);
+    this->current_ = page;
+    p.last_shown = millis();
+  }
+
+  void build(uint8_t page)
+  {
+    uint32_t start = millis();
+    uint32_t used = lvgl_mem_used();
+    Page &p = this->pages_[page];
+    p.screen = lv_obj_create(NULL);
+    for (LvglObjectBase *widget : LvglObjectBase::paged_widgets())
+      if (widget->get_page() == page)
+        widget->build(p.screen);
+    if (p.builder)
+      p.builder(p.screen);
+
+    p.mem = lvgl_mem_used() - used;
+    this->stats.builds++;
+    ESP_LOGD("lvgl", "Page %u built in %u ms, %u bytes of lvgl memory", page, (unsigned)(millis() - start),
+             (unsigned)p.mem);
+  }
+
+  void evict(uint8_t page)
+  {
+    Page &p = this->pages_[page];
+    for (LvglObjectBase *widget : LvglObjectBase::paged_widgets())
+      if (widget->get_page() == page)
+        widget->release();
+    lv_obj_del(p.screen);
+    p.screen = NULL;
+    this->stats.evictions++;
+    ESP_LOGD("lvgl", "Page %u deleted, %u bytes of lvgl memory in use", page, (unsigned)lvgl_mem_used());
+  }
+
+  /* Delete pages not shown, oldest first, until need more bytes fit the budget */
+  void make_room(uint32_t need, uint8_t keep)
+  {
+    while (lvgl_mem_used() + need > this->budget_)
+    {
+      uint8_t oldest = 0;
+      for (uint8_t i = 1; i < this->count_; i++)
+        if (this->pages_[i].screen != NULL && i != this->current_ && i != keep &&
+            (oldest == 0 || (int32_t)(this->pages_[i].last_shown - this->pages_[oldest].last_shown) < 0))
+          oldest = i;
+      if (oldest == 0)
+        return; // only page 0 and the shown page left
+      evict(oldest);
+    }
+  }
+
+  static void idle_cb(lv_timer_t *timer)
+  {
+    LvglPageManager *self = (LvglPageManager *)timer->user_data;
+    uint8_t next = (self->current_ + 1) % self->count_;
+    Page &p = self->pages_[next];
+    lv_disp_t *disp = lv_disp_get_default();
+    if (p.screen != NULL || disp == NULL || disp->inv_p > 0 || lv_anim_count_running() > 0 ||
+        lv_disp_get_inactive_time(disp) < LVGL_PAGE_PRELOAD_MS)
+      return;
+    if (p.mem == 0 || lvgl_mem_used() + p.mem > self->budget_)
+      return; // unknown size or no room, it is built when shown
+
+    self->build(next);
+    self->stats.preloads++;
+  }
+};
+
+// Widgets and yaml lambdas reach the same manager, it registers itself on first use
+LvglPageManager *lvgl_pages()
+{
+  static LvglPageManager *pages = NULL;
+  if (pages == NULL)
+  {
+    pages = new LvglPageManager();
+    App.register_component(pages);
+  }
+  return pages;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "esphome.h"
+#include "lvgl.h"
+
+/* Histogram with two buckets per octave, 0 to 2^31, for percentiles of timings and sizes.
+   Cheap enough to be fed from the flush path, read and cleared by LvglPerfSensor. */
+class PerfHistogram
+{
+public:
+  void IRAM_ATTR add(uint32_t v)
+  {
+    uint8_t b = bucket(v);
+    if (this->counts_[b] < UINT16_MAX)
+      this->counts_[b]++;
+    this->count_++;
+    if (v > this->max_)
+      this->max_ = v;
+  }
+
+  uint32_t count() { return this->count_; }
+  uint32_t max() { return this->max_; }
+
+  /* Upper bound of the bucket holding the p-th percentile, 0 when empty */
+  uint32_t percentile(uint8_t p)
+  {
+    uint32_t total = 0;
+    for (uint8_t b = 0; b < BUCKETS; b++)
+      total += this->counts_[b];
+    if (total == 0)
+      return 0;
+
+    uint32_t rank = (total * p + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t b = 0; b < BUCKETS; b++)
+    {
+      seen += this->counts_[b];
+      if (seen >= rank)
+        return LV_MIN(upper(b), this->max_);
+    }
+    return this->max_;
+  }
+
+  void clear()
+  {
+    memset(this->counts_, 0, sizeof(this->counts_));
+    this->count_ = 0;
+    this->max_ = 0;
+  }
+
+private:
+  static const uint8_t BUCKETS = 64;
+  uint16_t counts_[BUCKETS] = {};
+  uint32_t count_ = 0;
+  uint32_t max_ = 0;
+
+  // 0 and 1 get their own buckets, above that two per power of two: [2^n, 1.5 * 2^n) and [1.5 * 2^n, 2^(n+1))
+  static uint8_t bucket(uint32_t v)
+  {
+    if (v < 2)
+      return v;
+    uint8_t n = 31 - __builtin_clz(v);
+    return 2 * n + ((v >> (n - 1)) & 1);
+  }
+  static uint32_t upper(uint8_t b)
+  {
+    if (b < 2)
+      return b;
+    uint8_t n = b / 2;
+    return (b & 1) ? (uint32_t)((2ULL << n) - 1) : (uint32_t)((3ULL << (n - 1)) - 1);
+  }
+};
+
+/* UI performance, replaces the on-screen LV_USE_PERF_MONITOR overlay */
+struct lvgl_perf_t
+{
+  PerfHistogram render_us;  /* rendering per refresh */
+  PerfHistogram flush_us;   /* gui_flush_cb and waiting for the TFT per refresh */
+  PerfHistogram bytes;      /* sent to the TFT per refresh */
+  PerfHistogram area_px;    /* invalidated area per refresh, after joining */
+  PerfHistogram handler_us; /* lv_timer_handler calls */
+  uint32_t frames;          /* refreshes that flushed something */
+};
+static lvgl_perf_t lvgl_perf;
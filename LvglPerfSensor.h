@@ -0,0 +1,60 @@
+#pragma once
+
+#include "esphome.h"
+#include "LvglComponent.h"
+
+#ifdef USE_SENSOR // Sensor only exists when the yaml has a sensor: component
+// Percentiles of one metric over an update interval
+struct LvglPercentileSensors
+{
+  Sensor *p50 = new Sensor();
+  Sensor *p95 = new Sensor();
+  Sensor *p99 = new Sensor();
+
+  void publish(const char *name, PerfHistogram &h)
+  {
+    uint32_t p50_v = h.percentile(50), p95_v = h.percentile(95), p99_v = h.percentile(99);
+    p50->publish_state(p50_v);
+    p95->publish_state(p95_v);
+    p99->publish_state(p99_v);
+    ESP_LOGD("lvgl.perf", "%-10s p50 %7u  p95 %7u  p99 %7u  max %7u  (%u samples)", name, (unsigned)p50_v,
+             (unsigned)p95_v, (unsigned)p99_v, (unsigned)h.max(), (unsigned)h.count());
+  }
+};
+
+// Render and flush performance, published every update interval instead of the on-screen perf monitor
+class LvglPerfSensor : public PollingComponent
+{
+public:
+  LvglPercentileSensors render;  // us per refresh
+  LvglPercentileSensors flush;   // us per refresh
+  LvglPercentileSensors bytes;   // sent to the TFT per refresh
+  LvglPercentileSensors area;    // invalidated pixels per refresh
+  LvglPercentileSensors handler; // us per lv_timer_handler call
+  Sensor *fps_sensor = new Sensor();
+
+  LvglPerfSensor(uint32_t update_interval = 10000) : PollingComponent(update_interval) {}
+
+  void update() override
+  {
+    // A copy, the histograms are fed by the render task when there is one
+    lvgl_perf_take(&this->perf_);
+    uint32_t now = millis();
+    float fps = this->last_ms_ ? this->perf_.frames * 1000.0f / (now - this->last_ms_) : 0;
+    this->last_ms_ = now;
+
+    fps_sensor->publish_state(fps);
+    ESP_LOGD("lvgl.perf", "%.1f fps", fps);
+    render.publish("render_us", this->perf_.render_us);
+    flush.publish("flush_us", this->perf_.flush_us);
+    bytes.publish("bytes", this->perf_.bytes);
+    area.publish("area_px", this->perf_.area_px);
+    handler.publish("handler_us", this->perf_.handler_us);
+  }
+  float get_setup_priority() const override { return esphome::setup_priority::LATE; }
+
+private:
+  uint32_t last_ms_ = 0;
+  lvgl_perf_t perf_;
+};
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include "esphome.h"
+
+#ifndef LVGL_PUBLISH_MIN_INTERVAL
+#define LVGL_PUBLISH_MIN_INTERVAL 0 /* [ms] between two publishes of the same entity */
+#endif
+
+/* Collects the switch states changed during a lv_timer_handler pass and publishes them once per frame.
+   Only the last state of an entity is sent, and not more often than the minimum interval. */
+class LvglStatePublisher
+{
+public:
+  struct Stats
+  {
+    uint32_t queued;     /* state changes reported by widgets */
+    uint32_t sent;       /* publish_state calls */
+    uint32_t suppressed; /* changes overwritten within a frame or equal to the published state */
+  } stats = {};
+
+  void set_min_interval(uint16_t ms) { this->min_interval_ = ms; }
+
+  void queue(Switch *sw, bool state)
+  {
+    this->stats.queued++;
+    for (auto &entry : this->entries_)
+    {
+      if (entry.sw != sw)
+        continue;
+      if (entry.pending)
+        this->stats.suppressed++;
+      entry.state = state;
+      entry.pending = true;
+      this->pending_ = true;
+      return;
+    }
+    this->entries_.push_back({sw, 0, state, true, false});
+    this->pending_ = true;
+  }
+
+  /* Called once per frame, after lv_timer_handler */
+  void flush(uint32_t now)
+  {
+    if (!this->pending_)
+      return;
+
+    this->pending_ = false;
+    for (auto &entry : this->entries_)
+    {
+      if (!entry.pending)
+        continue;
+
+      if (entry.published && now - entry.last_ms < this->min_interval_)
+      {
+        this->pending_ = true; // try again next frame
+        continue;
+      }
+
+      entry.pending = false;
+      if (entry.published && entry.sw->state == entry.state)
+      {
+        this->stats.suppressed++;
+        continue;
+      }
+
+      entry.published = true;
+      entry.last_ms = now;
+      this->stats.sent++;
+      entry.sw->publish_state(entry.state);
+    }
+  }
+
+  bool has_pending() { return this->pending_; }
+
+private:
+  struct Entry
+  {
+    Switch *sw;
+    uint32_t last_ms;
+    bool state;
+    bool pending;
+    bool published;
+  };
+  std::vector<Entry> entries_;
+  uint16_t min_interval_ = LVGL_PUBLISH_MIN_INTERVAL;
+  bool pending_ = false;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "esphome.h"
+#include "lvgl.h"
+
+#ifndef LVGL_SHADOW_MAX_RECTS
+#define LVGL_SHADOW_MAX_RECTS 64 /* windows one flushed area can be split into */
+#endif
+
+/* Changed part of a flushed area, its pixels start at offset in the packed area buffer */
+struct shadow_rect_t
+{
+  lv_coord_t x1;
+  lv_coord_t y1;
+  lv_coord_t x2;
+  lv_coord_t y2;
+  uint32_t offset;
+};
+
+/* Copy of what the panel shows, enabled with -D LVGL_SHADOW_FB. lvgl redraws whole object areas,
+   the shadow finds the pixels of a rendered area that actually changed, so that only those are sent.
+   Changed pixels of a row are grouped into spans, unchanged gaps shorter than the window cost are
+   sent along, and a span directly below an equal one extends its window. */
+class ShadowFramebuffer
+{
+public:
+  shadow_rect_t rects[LVGL_SHADOW_MAX_RECTS];
+
+  void attach(uint16_t *fb, lv_coord_t width, lv_coord_t height, uint32_t window_cost)
+  {
+    this->fb_ = fb;
+    this->width_ = width;
+    this->height_ = height;
+    this->window_cost_ = window_cost;
+  }
+  bool enabled() { return this->fb_ != NULL; }
+
+  // The panel was drawn behind the back of lvgl, compare again once a full frame has been sent
+  void invalidate()
+  {
+    this->valid_ = false;
+    this->covered_ = 0;
+  }
+
+  /* Called after each refresh, the shadow becomes valid when the whole screen has been sent */
+  void end_refresh()
+  {
+    if (!this->valid_ && this->covered_ >= (uint32_t)this->width_ * this->height_)
+      this->valid_ = true;
+    this->covered_ = 0;
+  }
+
+  /* Compare an area rendered into px with the shadow and update the shadow.
+     Returns -1 when the whole area is cheaper to send, otherwise the number of rects, whose pixels
+     have been packed to the front of px in rect order. sent is set to the pixels to send. */
+  int16_t IRAM_ATTR diff(const lv_area_t *area, uint16_t *px, uint32_t *sent)
+  {
+    lv_coord_t w = lv_area_get_width(area);
+    lv_coord_t h = lv_area_get_height(area);
+    uint32_t len = (uint32_t)w * h;
+    uint16_t *shadow = this->fb_ + (uint32_t)area->y1 * this->width_ + area->x1;
+
+    int16_t n = this->valid_ ? find_rects(area, px, shadow, len + this->window_cost_) : -1;
+    if (n < 0)
+    {
+      for (lv_coord_t y = 0; y < h; y++)
+        memcpy(shadow + (uint32_t)y * this->width_, px + (uint32_t)y * w, w * sizeof(uint16_t));
+      this->covered_ += len;
+      *sent = len;
+      return -1;
+    }
+
+    /* Pack the changed pixels, the rects are in row order so the writes never pass the reads */
+    uint32_t out = 0;
+    for (int16_t i = 0; i < n; i++)
+    {
+      shadow_rect_t &r = this->rects[i];
+      lv_coord_t rw = r.x2 - r.x1 + 1;
+      r.offset = out;
+      for (lv_coord_t y = r.y1; y <= r.y2; y++)
+      {
+        uint16_t *src = px + (uint32_t)(y - area->y1) * w + (r.x1 - area->x1);
+        memcpy(this->fb_ + (uint32_t)y * this->width_ + r.x1, src, rw * sizeof(uint16_t));
+        memmove(px + out, src, rw * sizeof(uint16_t));
+        out += rw;
+      }
+    }
+    *sent = out;
+    return n;
+  }
+
+private:
+  uint16_t *fb_ = NULL;
+  lv_coord_t width_ = 0;
+  lv_coord_t height_ = 0;
+  uint32_t window_cost_ = 0;
+  bool valid_ = false;   /* the shadow matches the panel */
+  uint32_t covered_ = 0; /* pixels sent whole during this refresh while not valid */
+
+  /* Returns the number of rects, or -1 once they cost at least give_up pixels */
+  int16_t IRAM_ATTR find_rects(const lv_area_t *area, const uint16_t *px, const uint16_t *shadow, uint32_t give_up)
+  {
+    lv_coord_t w = lv_area_get_width(area);
+    lv_coord_t h = lv_area_get_height(area);
+    int16_t n = 0;
+    uint32_t cost = 0;
+
+    for (lv_coord_t y = 0; y < h; y++)
+    {
+      const uint16_t *src = px + (uint32_t)y * w;
+      const uint16_t *old = shadow + (uint32_t)y * this->width_;
+      lv_coord_t x = 0;
+      bool first = true;
+      while (x < w)
+      {
+        while (x < w && src[x] == old[x])
+          x++;
+        if (x == w)
+          break;
+
+        // Extend the span over gaps that are cheaper to send than a new window
+        lv_coord_t start = x;
+        lv_coord_t end = x;
+        for (x++; x < w && (uint32_t)(x - end) <= this->window_cost_; x++)
+          if (src[x] != old[x])
+            end = x;
+
+        lv_coord_t x1 = area->x1 + start;
+        lv_coord_t x2 = area->x1 + end;
+        lv_coord_t sy = area->y1 + y;
+        shadow_rect_t *last = n > 0 ? &this->rects[n - 1] : NULL;
+        if (first && last != NULL && last->x1 == x1 && last->x2 == x2 && last->y2 == sy - 1)
+          last->y2 = sy;
+        else if (n < LVGL_SHADOW_MAX_RECTS)
+        {
+          this->rects[n++] = {x1, sy, x2, sy, 0};
+          cost += this->window_cost_;
+        }
+        else
+          return -1;
+
+        cost += end - start + 1;
+        if (cost >= give_up)
+          return -1;
+        first = false;
+      }
+    }
+    return n;
+  }
+};
@@ -0,0 +1,230 @@
+#pragma once
+
+// Static objects drawn from a snapshot, enabled with -D LVGL_SNAPSHOT
+//
+// An object and its children are rendered once into an image (lv_snapshot), which an lv_img placed
+// right behind the object shows from then on. The object itself is made transparent, so its radius
+// masks, shadows and gradients are not rendered again when something overlapping it is redrawn, but
+// it stays in place and still gets input.
+// Any change lvgl reports on the object or its children (style, state through input, size, added or
+// removed children) drops the snapshot, a new one is taken once nothing has changed for
+// LVGL_SNAPSHOT_SETTLE_MS. Changes lvgl does not report, like a label text of the same size, need a
+// call to invalidate(). Snapshots inside snapshotted objects are not supported.
+
+#ifdef LVGL_SNAPSHOT
+
+#include <stdlib.h>
+#include "esphome.h"
+#include "lvgl.h"
+#ifdef ARDUINO_ARCH_ESP32
+#include "esp_heap_caps.h"
+#endif
+
+#ifndef LVGL_SNAPSHOT_SETTLE_MS
+#define LVGL_SNAPSHOT_SETTLE_MS 300 /* [ms] without changes before an object is snapshotted again */
+#endif
+
+/* All snapshots, cumulative since boot */
+struct snapshot_stats_t
+{
+  uint32_t taken;         /* snapshots rendered */
+  uint32_t invalidations; /* changes that dropped a snapshot */
+  uint32_t bytes;         /* held by the snapshot buffers */
+};
+static snapshot_stats_t snapshot_stats;
+
+class LvglSnapshot
+{
+public:
+  // opaque: the object covers all of its area, no alpha channel is needed
+  LvglSnapshot(lv_obj_t *obj, bool opaque = false) : obj_(obj), opaque_(opaque)
+  {
+    this->img_ = lv_img_create(lv_obj_get_parent(obj));
+    lv_obj_add_flag(this->img_, LV_OBJ_FLAG_HIDDEN | LV_OBJ_FLAG_IGNORE_LAYOUT | LV_OBJ_FLAG_FLOATING);
+    lv_obj_clear_flag(this->img_, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(this->img_, img_deleted_cb, LV_EVENT_DELETE, this);
+    watch(obj);
+
+    this->timer_ = lv_timer_create(timer_cb, LVGL_SNAPSHOT_SETTLE_MS, this); // first snapshot once settled
+  }
+
+  bool is_cached() { return this->cached_; }
+
+  /* Something changed that lvgl does not report, draw the object again until it has settled */
+  void invalidate()
+  {
+    if (this->cached_)
+    {
+      this->applying_ = true;
+      lv_obj_remove_local_style_prop(this->obj_, LV_STYLE_OPA, 0);
+      if (this->img_ != NULL)
+        lv_obj_add_flag(this->img_, LV_OBJ_FLAG_HIDDEN);
+      this->applying_ = false;
+      this->cached_ = false;
+      snapshot_stats.invalidations++;
+    }
+    lv_timer_reset(this->timer_);
+    lv_timer_resume(this->timer_);
+  }
+
+  /* Report a change made outside of lvgl's input handling, e.g. a state set from Home Assistant.
+     Does nothing for objects without a snapshot. */
+  static void changed(lv_obj_t *obj) { lv_event_send(obj, changed_event(), NULL); }
+
+private:
+  lv_obj_t *obj_;
+  lv_obj_t *img_;
+  lv_timer_t *timer_;
+  lv_img_dsc_t dsc_;
+  uint8_t *buf_ = NULL;
+  uint32_t buf_size_ = 0;
+  bool opaque_;
+  bool cached_ = false;
+  bool applying_ = false; /* our own style change, not a reason to drop the snapshot */
+
+  static lv_event_code_t changed_event()
+  {
+    static lv_event_code_t code = (lv_event_code_t)lv_event_register_id();
+    return code;
+  }
+
+  // Listen to the object and all of its children
+  void watch(lv_obj_t *obj)
+  {
+    lv_obj_remove_event_cb_with_user_data(obj, event_cb, this);
+    lv_obj_add_event_cb(obj, event_cb, LV_EVENT_ALL, this);
+    for (uint32_t i = 0; i < lv_obj_get_child_cnt(obj); i++)
+      watch(lv_obj_get_child(obj, i));
+  }
+
+  // lvgl deletes the object before its children, they must not call back into a deleted snapshot
+  void unwatch(lv_obj_t *obj)
+  {
+    lv_obj_remove_event_cb_with_user_data(obj, event_cb, this);
+    for (uint32_t i = 0; i < lv_obj_get_child_cnt(obj); i++)
+      unwatch(lv_obj_get_child(obj, i));
+  }
+
+  bool take()
+  {
+    if (lv_obj_has_flag(this->obj_, LV_OBJ_FLAG_HIDDEN))
+      return false;
+
+    lv_img_cf_t cf = this->opaque_ ? LV_IMG_CF_TRUE_COLOR : LV_IMG_CF_TRUE_COLOR_ALPHA;
+    uint32_t size = lv_snapshot_buf_size_needed(this->obj_, cf);
+    if (size == 0)
+      return false;
+    if (size != this->buf_size_)
+    {
+      free_buffer(this->buf_);
+      snapshot_stats.bytes -= this->buf_size_;
+      this->buf_ = (uint8_t *)alloc(size);
+      this->buf_size_ = this->buf_ != NULL ? size : 0;
+      snapshot_stats.bytes += this->buf_size_;
+    }
+    if (this->buf_ == NULL || lv_snapshot_take_to_buf(this->obj_, cf, &this->dsc_, this->buf_, size) != LV_RES_OK)
+      return false;
+
+    // Right behind the object, the snapshot includes what it draws outside of its area, e.g. shadows
+    lv_img_cache_invalidate_src(&this->dsc_);
+    lv_img_set_src(this->img_, &this->dsc_);
+    uint32_t index = lv_obj_get_index(this->obj_);
+    if (lv_obj_get_index(this->img_) < index)
+      index--;
+    lv_obj_move_to_index(this->img_, index);
+    lv_obj_align_to(this->img_, this->obj_, LV_ALIGN_CENTER, 0, 0);
+
+    this->applying_ = true;
+    lv_obj_set_style_opa(this->obj_, LV_OPA_TRANSP, 0); // with its children, still clickable
+    lv_obj_clear_flag(this->img_, LV_OBJ_FLAG_HIDDEN);
+    this->applying_ = false;
+    this->cached_ = true;
+    snapshot_stats.taken++;
+    return true;
+  }
+
+  static void timer_cb(lv_timer_t *timer)
+  {
+    LvglSnapshot *self = (LvglSnapshot *)timer->user_data;
+    lv_timer_pause(timer);
+    if (self->img_ != NULL)
+      self->take();
+  }
+
+  static void event_cb(lv_event_t *e)
+  {
+    LvglSnapshot *self = (LvglSnapshot *)lv_event_get_user_data(e);
+    lv_event_code_t code = lv_event_get_code(e);
+    if (code == LV_EVENT_DELETE)
+    {
+      if (lv_event_get_current_target(e) == self->obj_)
+        delete self;
+      return;
+    }
+    if (self->applying_)
+      return;
+
+    switch (code)
+    {
+    case LV_EVENT_CHILD_CHANGED:
+      self->watch(self->obj_);
+      self->invalidate();
+      break;
+    case LV_EVENT_STYLE_CHANGED:
+    case LV_EVENT_SIZE_CHANGED:
+    case LV_EVENT_PRESSED:
+    case LV_EVENT_RELEASED:
+    case LV_EVENT_PRESS_LOST:
+    case LV_EVENT_VALUE_CHANGED:
+    case LV_EVENT_FOCUSED:
+    case LV_EVENT_DEFOCUSED:
+      self->invalidate();
+      break;
+    default:
+      if (code == changed_event())
+        self->invalidate();
+      break;
+    }
+  }
+
+  // The parent is being deleted, it takes the image with it
+  static void img_deleted_cb(lv_event_t *e) { ((LvglSnapshot *)lv_event_get_user_data(e))->img_ = NULL; }
+
+  // Only from the object's LV_EVENT_DELETE, its own callback is left to lvgl: removing it while lvgl
+  // walks the object's callbacks would shift the next one out of the walk
+  ~LvglSnapshot()
+  {
+    for (uint32_t i = 0; i < lv_obj_get_child_cnt(this->obj_); i++)
+      unwatch(lv_obj_get_child(this->obj_, i));
+    lv_timer_del(this->timer_);
+    if (this->img_ != NULL)
+    {
+      lv_obj_remove_event_cb_with_user_data(this->img_, img_deleted_cb, this);
+      lv_obj_del(this->img_);
+    }
+    free_buffer(this->buf_);
+    snapshot_stats.bytes -= this->buf_size_;
+  }
+
+  // In PSRAM when there is some, internal RAM is kept for the draw buffers
+  static void *alloc(size_t bytes)
+  {
+#ifdef ARDUINO_ARCH_ESP32
+    void *p = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p != NULL ? p : heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#else
+    return malloc(bytes);
+#endif
+  }
+
+  static void free_buffer(void *p)
+  {
+#ifdef ARDUINO_ARCH_ESP32
+    heap_caps_free(p);
+#else
+    free(p);
+#endif
+  }
+};
+
+#endif // LVGL_SNAPSHOT
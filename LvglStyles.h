@@ -0,0 +1,121 @@
+#pragma once
+
+// Shared styles, referenced by id from widgets, flash layouts and yaml lambdas
+//
+// A style is a table of constant properties, terminated by LV_STYLE_PROP_INV:
+//   static const lv_style_const_prop_t red_props[] = {
+//       LV_STYLE_CONST_BG_COLOR(LV_COLOR_MAKE(0xF4, 0x43, 0x36)), LV_STYLE_PROP_INV};
+// lvgl reads the properties in place, so a style costs no lvgl heap and the built-in ones no RAM at all.
+// Tables with the same properties share one id, every object using it shares one style: lvgl
+// compares a single style pointer per object instead of resolving local style copies.
+
+#include <string.h>
+#include "esphome.h"
+#include "lvgl.h"
+
+#ifndef LVGL_STYLES_MAX
+#define LVGL_STYLES_MAX 16 /* style ids, including the built-in ones */
+#endif
+
+// LV_STYLE_CONST_INIT with the designators in declaration order, as C++ requires
+#if LV_USE_ASSERT_STYLE
+#define LVGL_STYLE_CONST(props)                                                                                      \
+  {                                                                                                                  \
+    .sentinel = LV_STYLE_SENTINEL_VALUE, .v_p = {.const_props = props}, .prop1 = LV_STYLE_PROP_ANY, .has_group = 0xFF, \
+    .prop_cnt = sizeof(props) / sizeof((props)[0])                                                                   \
+  }
+#else
+#define LVGL_STYLE_CONST(props)                                                                                     \
+  {                                                                                                                 \
+    .v_p = {.const_props = props}, .prop1 = LV_STYLE_PROP_ANY, .has_group = 0xFF,                                  \
+    .prop_cnt = sizeof(props) / sizeof((props)[0])                                                                  \
+  }
+#endif
+
+/* Built-in style ids, lvgl_layout_item_t::style uses the same ids */
+enum lvgl_style_id_t : uint8_t
+{
+  STYLE_NONE = 0, /* the theme only */
+  STYLE_SWITCH,   /* unchecked switches darker grey */
+  STYLE_BUILTIN_COUNT,
+};
+
+static const lv_style_const_prop_t style_switch_props[] = {
+    LV_STYLE_CONST_BG_COLOR(LV_COLOR_MAKE(0x9E, 0x9E, 0x9E)), // lv_palette_main(LV_PALETTE_GREY)
+    LV_STYLE_PROP_INV,
+};
+static const lv_style_t style_switch = LVGL_STYLE_CONST(style_switch_props);
+
+class LvglStyles
+{
+public:
+  LvglStyles()
+  {
+    this->styles_[STYLE_NONE] = NULL;
+    this->styles_[STYLE_SWITCH] = &style_switch;
+  }
+
+  /* Id of a style with these properties, registered on first use. props must stay valid, e.g. static const. */
+  uint8_t add(const lv_style_const_prop_t *props)
+  {
+    for (uint8_t id = STYLE_NONE + 1; id < this->count_; id++)
+      if (same(this->styles_[id]->v_p.const_props, props))
+      {
+        this->shared_++;
+        return id;
+      }
+    if (this->count_ == LVGL_STYLES_MAX)
+    {
+      ESP_LOGW("lvgl", "No room for another style, raise LVGL_STYLES_MAX");
+      return STYLE_NONE;
+    }
+
+    uint8_t count = 1;
+    while (props[count - 1].prop != LV_STYLE_PROP_INV)
+      count++;
+    lv_style_t *style = new lv_style_t(); // the properties stay where they are
+#if LV_USE_ASSERT_STYLE
+    style->sentinel = LV_STYLE_SENTINEL_VALUE;
+#endif
+    style->v_p.const_props = props;
+    style->prop1 = LV_STYLE_PROP_ANY;
+    style->has_group = 0xFF;
+    style->prop_cnt = count;
+    this->styles_[this->count_] = style;
+    return this->count_++;
+  }
+
+  // lvgl takes styles as non-const but never writes to a constant one
+  lv_style_t *get(uint8_t id) { return id < this->count_ ? (lv_style_t *)this->styles_[id] : NULL; }
+
+  void apply(lv_obj_t *obj, uint8_t id, lv_style_selector_t selector = 0)
+  {
+    lv_style_t *style = get(id);
+    if (style != NULL)
+      lv_obj_add_style(obj, style, selector);
+  }
+
+  uint8_t get_count() { return this->count_; }
+  /* add() calls answered with an existing id */
+  uint32_t get_shared() { return this->shared_; }
+
+private:
+  const lv_style_t *styles_[LVGL_STYLES_MAX];
+  uint8_t count_ = STYLE_BUILTIN_COUNT;
+  uint32_t shared_ = 0;
+
+  static bool same(const lv_style_const_prop_t *a, const lv_style_const_prop_t *b)
+  {
+    for (;; a++, b++)
+    {
+      if (a->prop != b->prop)
+        return false;
+      if (a->prop == LV_STYLE_PROP_INV)
+        return true;
+      if (memcmp(&a->value, &b->value, sizeof(a->value)) != 0)
+        return false;
+    }
+  }
+};
+
+static LvglStyles lvgl_styles;
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#ifdef ARDUINO_ARCH_ESP32
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#else
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+#ifndef LVGL_TASK_CORE
+#define LVGL_TASK_CORE 0 /* the Arduino loop task runs on core 1 */
+#endif
+#ifndef LVGL_TASK_STACK
+#define LVGL_TASK_STACK 8192 /* [bytes] */
+#endif
+#ifndef LVGL_TASK_PRIORITY
+#define LVGL_TASK_PRIORITY 2 /* above the loop task, lvgl sleeps whenever it has nothing to draw */
+#endif
+#ifndef LVGL_QUEUE_LEN
+#define LVGL_QUEUE_LEN 32 /* commands into and events out of the render task, power of two */
+#endif
+
+/* Bounded lock-free queue, any number of producers and one consumer.
+   Every slot carries a sequence number telling whose turn it is, so producers only contend on
+   the tail index and never wait for each other or for the consumer. */
+template <class T, uint32_t N>
+class LvglQueue
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "queue length must be a power of two");
+
+public:
+  LvglQueue()
+  {
+    for (uint32_t i = 0; i < N; i++)
+      this->slots_[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  /* Returns false when the queue is full */
+  bool push(const T &item)
+  {
+    uint32_t pos = this->tail_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      Slot &slot = this->slots_[pos & (N - 1)];
+      int32_t diff = (int32_t)(slot.seq.load(std::memory_order_acquire) - pos);
+      if (diff == 0)
+      {
+        if (this->tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          slot.item = item;
+          slot.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0)
+        return false; // the consumer has not taken the item of the previous round yet
+      else
+        pos = this->tail_.load(std::memory_order_relaxed); // another producer took this slot
+    }
+  }
+
+  /* Consumer only, returns false when the queue is empty */
+  bool pop(T *item)
+  {
+    uint32_t pos = this->head_.load(std::memory_order_relaxed);
+    Slot &slot = this->slots_[pos & (N - 1)];
+    if ((int32_t)(slot.seq.load(std::memory_order_acquire) - (pos + 1)) < 0)
+      return false;
+
+    *item = slot.item;
+    slot.seq.store(pos + N, std::memory_order_release);
+    this->head_.store(pos + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<uint32_t> seq;
+    T item;
+  };
+  Slot slots_[N];
+  std::atomic<uint32_t> tail_{0}; /* next slot a producer claims */
+  std::atomic<uint32_t> head_{0}; /* next slot the consumer reads */
+};
+
+/* The task lvgl runs in with -D LVGL_RENDER_TASK, a FreeRTOS task pinned to LVGL_TASK_CORE on the ESP32
+   and a std::thread on the host */
+class LvglThread
+{
+public:
+  void start(void (*fn)(void *), void *arg)
+  {
+    this->fn_ = fn;
+    this->arg_ = arg;
+    this->running_.store(true);
+#ifdef ARDUINO_ARCH_ESP32
+    TaskHandle_t handle;
+    xTaskCreatePinnedToCore(entry, "lvgl", LVGL_TASK_STACK, this, LVGL_TASK_PRIORITY, &handle, LVGL_TASK_CORE);
+    this->handle_.store(handle);
+#else
+    std::thread(entry, this).detach(); // runs as long as the application
+#endif
+  }
+
+  bool running() { return this->running_.load(std::memory_order_relaxed); }
+  // True when called from the render task itself
+  bool is_current() { return in_task(); }
+
+  /* Render task only, returns early when wake() is called */
+  void sleep(uint32_t ms)
+  {
+#ifdef ARDUINO_ARCH_ESP32
+    TickType_t ticks = pdMS_TO_TICKS(ms);
+    ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1); // always yield, the idle task feeds the watchdog
+#else
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    this->cond_.wait_for(lock, std::chrono::milliseconds(ms), [this] { return this->woken_; });
+    this->woken_ = false;
+#endif
+  }
+
+  void wake()
+  {
+#ifdef ARDUINO_ARCH_ESP32
+    TaskHandle_t handle = this->handle_.load();
+    if (handle != NULL)
+      xTaskNotifyGive(handle);
+#else
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      this->woken_ = true;
+    }
+    this->cond_.notify_one();
+#endif
+  }
+
+private:
+  void (*fn_)(void *) = NULL;
+  void *arg_ = NULL;
+  std::atomic<bool> running_{false};
+#ifdef ARDUINO_ARCH_ESP32
+  std::atomic<TaskHandle_t> handle_{NULL};
+#else
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool woken_ = false;
+#endif
+
+  static bool &in_task()
+  {
+    static thread_local bool flag = false;
+    return flag;
+  }
+
+  static void entry(void *arg)
+  {
+    LvglThread *self = (LvglThread *)arg;
+    in_task() = true;
+#ifdef ARDUINO_ARCH_ESP32
+    self->handle_.store(xTaskGetCurrentTaskHandle()); // wake() may run before xTaskCreatePinnedToCore returns
+#endif
+    self->fn_(self->arg_);
+#ifdef ARDUINO_ARCH_ESP32
+    vTaskDelete(NULL);
+#endif
+  }
+};
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include "esphome.h"
+#include "lvgl.h"
+
+#ifndef TOUCH_SAMPLE_PERIOD
+#define TOUCH_SAMPLE_PERIOD 15 /* [ms] between samples while the screen is touched */
+#endif
+#ifndef TOUCH_IDLE_PERIOD
+#define TOUCH_IDLE_PERIOD 50 /* [ms] between samples while released and there is no IRQ line */
+#endif
+
+/* Raw touch samples from a controller, a fake one can be plugged in to test the sampler */
+class TouchSource
+{
+public:
+  virtual void begin() {}
+  /* State of the pen/interrupt line, sources without one always report true */
+  virtual bool has_irq() { return false; }
+  virtual bool pen_down() { return true; }
+  /* Set to false while the bus is in use and the sample has to be postponed */
+  virtual bool bus_free() { return true; }
+  /* True for a bus other components use from the main loop, e.g. I2C: the source is then sampled from the
+     main loop, also when lvgl runs in a render task */
+  virtual bool main_loop_bus() { return false; }
+  virtual bool read(uint16_t *x, uint16_t *y) = 0;
+};
+
+/* Median of three samples followed by an IIR low-pass, fed at a fixed rate and read by lvgl from the cache.
+   The filtered point is handed over in one atomic word, lvgl may read it in another thread than update(). */
+class TouchSampler
+{
+public:
+  struct Stats
+  {
+    uint32_t samples; /* controller reads */
+    uint32_t irq_skips; /* reads avoided because the IRQ line was idle */
+    uint32_t bus_skips; /* reads postponed because the display owned the bus */
+  } stats = {};
+
+  void set_source(TouchSource *source) { this->source_ = source; }
+  TouchSource *get_source() { return this->source_; }
+  void set_periods(uint16_t touched_ms, uint16_t idle_ms)
+  {
+    this->touched_period_ = touched_ms;
+    this->idle_period_ = idle_ms;
+  }
+
+  /* Called from the lvgl loop, or the main loop for main_loop_bus() sources, samples the controller when it is
+     due. Returns true when it sampled or released, lvgl has a new point to read. */
+  bool update(uint32_t now)
+  {
+    if (this->source_ == NULL)
+      return false;
+
+    if (this->source_->has_irq() && !this->source_->pen_down())
+    {
+      bool was_pressed = this->pressed_;
+      if (was_pressed)
+        release();
+      this->stats.irq_skips++;
+      return was_pressed;
+    }
+
+    uint16_t period = get_period();
+    if (now - this->last_sample_ < period)
+      return false;
+
+    if (!this->source_->bus_free())
+    {
+      this->stats.bus_skips++;
+      return false;
+    }
+
+    this->last_sample_ = now;
+    this->stats.samples++;
+
+    uint16_t x, y;
+    if (!this->source_->read(&x, &y))
+    {
+      release();
+      return true;
+    }
+
+    this->hist_x_[this->count_ % 3] = x;
+    this->hist_y_[this->count_ % 3] = y;
+    if (this->count_ == 0)
+    {
+      this->hist_x_[1] = this->hist_x_[2] = x;
+      this->hist_y_[1] = this->hist_y_[2] = y;
+      this->x_ = x << 2;
+      this->y_ = y << 2;
+    }
+    this->count_++;
+
+    /* IIR with weight 1/2 in 14.2 fixed point */
+    this->x_ = (this->x_ + (median(this->hist_x_) << 2)) >> 1;
+    this->y_ = (this->y_ + (median(this->hist_y_) << 2)) >> 1;
+    this->pressed_ = true;
+    this->point_ = POINT_PRESSED | ((this->y_ + 2) >> 2) << 16 | ((this->x_ + 2) >> 2);
+    return true;
+  }
+
+  /* Called by lvgl, never touches the bus */
+  void get(lv_indev_data_t *data)
+  {
+    uint32_t point = this->point_;
+    data->state = (point & POINT_PRESSED) ? LV_INDEV_STATE_PR : LV_INDEV_STATE_REL;
+    if (point & POINT_PRESSED)
+    {
+      data->point.x = point & 0xFFFF;
+      data->point.y = (point >> 16) & 0x7FFF;
+    }
+  }
+
+  bool is_pressed() { return this->point_ & POINT_PRESSED; }
+  // Time between two update() calls that sample or check the IRQ line
+  uint16_t get_period()
+  {
+    bool fast = is_pressed() || (this->source_ != NULL && this->source_->has_irq());
+    return fast ? this->touched_period_ : this->idle_period_;
+  }
+
+private:
+  TouchSource *source_ = NULL;
+  uint16_t touched_period_ = TOUCH_SAMPLE_PERIOD;
+  uint16_t idle_period_ = TOUCH_IDLE_PERIOD;
+  uint32_t last_sample_ = 0;
+  uint32_t count_ = 0;
+  uint16_t hist_x_[3];
+  uint16_t hist_y_[3];
+  uint32_t x_ = 0;
+  uint32_t y_ = 0;
+  bool pressed_ = false; /* owned by the thread calling update() */
+  static const uint32_t POINT_PRESSED = 0x80000000;
+  std::atomic<uint32_t> point_{0}; /* pressed flag, y and x of the filtered point, as lvgl reads it */
+
+  void release()
+  {
+    this->pressed_ = false;
+    this->count_ = 0;
+    this->point_ = 0;
+  }
+
+  static uint16_t median(const uint16_t *v)
+  {
+    uint16_t a = v[0], b = v[1], c = v[2];
+    if (a > b)
+      std::swap(a, b);
+    if (b > c)
+      std::swap(b, c);
+    return a > b ? a : b;
+  }
+};
+
+/* XPT2046 resistive controller on the display SPI bus, read through TFT_eSPI.
+   Define TOUCH_IRQ with the PENIRQ pin to skip the SPI read while nobody touches the screen. */
+class XPT2046TouchSource : public TouchSource
+{
+public:
+  void begin() override
+  {
+#ifdef TOUCH_IRQ
+    pinMode(TOUCH_IRQ, INPUT_PULLUP);
+#endif
+  }
+
+#ifdef TOUCH_IRQ
+  bool has_irq() override { return true; }
+  bool pen_down() override { return digitalRead(TOUCH_IRQ) == LOW; }
+#endif
+
+  bool bus_free() override { return gui_flush_poll(false); }
+
+  bool read(uint16_t *x, uint16_t *y) override
+  {
+    gui_flush_end_write();
+    return tft.getTouch(x, y, 600);
+  }
+};
+
+#ifdef USE_I2C
+/* FT6206/FT6236/FT6336 capacitive controller on an i2c: bus of the yaml, e.g. new FT6X36TouchSource(id(i2c_bus)).
+   It is read through that bus from the main loop, like every other I2C component, also with a render task.
+   Define TOUCH_INT with the interrupt pin to skip the I2C read while nobody touches the screen. */
+class FT6X36TouchSource : public TouchSource, public i2c::I2CDevice
+{
+public:
+  FT6X36TouchSource(i2c::I2CComponent *parent, uint8_t address = 0x38) : i2c::I2CDevice(parent, address) {}
+
+#ifdef TOUCH_INT
+  void begin() override { pinMode(TOUCH_INT, INPUT_PULLUP); }
+  bool has_irq() override { return true; }
+  bool pen_down() override { return digitalRead(TOUCH_INT) == LOW; }
+#endif
+
+  bool main_loop_bus() override { return true; }
+
+  bool read(uint16_t *x, uint16_t *y) override
+  {
+    uint8_t reg[5]; /* TD_STATUS, P1_XH, P1_XL, P1_YH, P1_YL */
+    if (!this->read_bytes(0x02, reg, sizeof(reg)))
+      return false;
+
+    uint8_t points = reg[0] & 0x0F;
+    if (points == 0 || points > 2)
+      return false;
+
+    uint16_t rx = ((reg[1] & 0x0F) << 8) | reg[2];
+    uint16_t ry = ((reg[3] & 0x0F) << 8) | reg[4];
+
+    /* The panel reports in native portrait orientation */
+    switch (TFT_ROTATION & 3)
+    {
+    case 1:
+      *x = ry;
+      *y = TFT_WIDTH - 1 - rx;
+      break;
+    case 2:
+      *x = TFT_WIDTH - 1 - rx;
+      *y = TFT_HEIGHT - 1 - ry;
+      break;
+    case 3:
+      *x = TFT_HEIGHT - 1 - ry;
+      *y = rx;
+      break;
+    default:
+      *x = rx;
+      *y = ry;
+    }
+    return true;
+  }
+};
+#endif
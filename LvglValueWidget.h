@@ -0,0 +1,227 @@
+#pragma once
+
+#include <math.h>
+#include <vector>
+#include "esphome.h"
+#include "lvgl.h"
+#include "LvglComponent.h"
+#include "LvglWidget.h"
+
+#ifndef LVGL_DRAG_PUBLISH_MS
+#define LVGL_DRAG_PUBLISH_MS 250 /* [ms] between two values published while a slider or arc is dragged */
+#endif
+
+/* Numeric widgets, see LvglValueBase::apply_desired. Cumulative since boot. */
+struct value_stats_t
+{
+  uint32_t updates;   /* values to show, from sensors or Home Assistant */
+  uint32_t coalesced; /* updates replaced by a later one within a refresh period */
+  uint32_t applied;   /* objects changed, each one an invalidation */
+  uint32_t drag_sent; /* values published while an object is dragged or on release */
+  uint32_t drag_held; /* drag values not published because one was sent less than LVGL_DRAG_PUBLISH_MS ago */
+};
+static value_stats_t value_stats;
+
+/* Shared part of the numeric widgets.
+   Values to show are coalesced: however often a sensor or Home Assistant sends one, the object is changed
+   at most once per display refresh period (LV_DISP_DEF_REFR_PERIOD), to the last value, and not at all
+   when it shows that value already. lvgl works in integer steps of the widget, step is what one is worth. */
+class LvglValueBase : public LvglObjectBase
+{
+public:
+  // Range in the unit of the bound entity, step is the smallest change shown. Set before setup.
+  void set_range(float min, float max, float step = 1.0f)
+  {
+    this->step_ = step;
+    this->min_ = lroundf(min / step);
+    this->max_ = lroundf(max / step);
+    this->desired_ = this->min_;
+  }
+
+  /* Show a value with the next refresh period, from any thread */
+  void show(float value)
+  {
+    if (!isnan(value))
+      lvgl_call(set_desired, this, to_raw(value));
+  }
+
+  void setup() override
+  {
+    // Widgets on other pages get their object when the page is shown
+    if (!this->created_ && this->page_ == 0)
+      attach(create_obj(lv_scr_act()));
+  }
+
+  void adopt(lv_obj_t *new_obj) override
+  {
+    LvglObjectBase::adopt(new_obj);
+    set_raw(this->desired_);
+  }
+
+protected:
+  int32_t min_ = 0;
+  int32_t max_ = 100;
+  float step_ = 1.0f;
+
+  LvglValueBase(lv_coord_t x, lv_coord_t y, lv_coord_t w, lv_coord_t h) : LvglObjectBase(x, y, w, h) {}
+
+  virtual int32_t get_raw() = 0;
+  virtual void set_raw(int32_t value) = 0;
+
+  int32_t to_raw(float value) { return LV_CLAMP(this->min_, (int32_t)lroundf(value / this->step_), this->max_); }
+  float from_raw(int32_t raw) { return raw * this->step_; }
+
+  static void set_desired(void *widget, int32_t value)
+  {
+    LvglValueBase *self = (LvglValueBase *)widget;
+    value_stats.updates++;
+    if (self->dirty_)
+      value_stats.coalesced++;
+    self->desired_ = value;
+    // Runs right away when the last change is a refresh period ago, else once the period is over
+    self->schedule(due_values());
+  }
+
+  void apply_desired() override
+  {
+    if (lv_obj_has_state(obj, LV_STATE_PRESSED))
+      return; // being dragged, applied on release unless the finger moves it first
+    if (get_raw() == this->desired_)
+      return;
+    value_stats.applied++;
+    set_raw(this->desired_);
+  }
+
+  static DueList &due_values()
+  {
+    static DueList due = {LV_DISP_DEF_REFR_PERIOD, report_stats};
+    return due;
+  }
+
+  static void report_stats()
+  {
+    ESP_LOGD("lvgl", "values: %u updates, %u coalesced, %u applied, drags %u published, %u held back",
+             (unsigned)value_stats.updates, (unsigned)value_stats.coalesced, (unsigned)value_stats.applied,
+             (unsigned)value_stats.drag_sent, (unsigned)value_stats.drag_held);
+  }
+};
+
+/* A numeric widget type is a traits struct with three functions:
+     static lv_obj_t *create(lv_obj_t *parent, int32_t min, int32_t max);
+     static int32_t get(lv_obj_t *obj);
+     static void set(lv_obj_t *obj, int32_t value);
+   see LvglSlider.h */
+template <class Traits>
+class LvglValueWidget : public LvglValueBase
+{
+public:
+  LvglValueWidget(lv_coord_t x, lv_coord_t y, lv_coord_t w, lv_coord_t h) : LvglValueBase(x, y, w, h) {}
+
+protected:
+  lv_obj_t *create_obj(lv_obj_t *parent) override { return Traits::create(parent, this->min_, this->max_); }
+  int32_t get_raw() override { return Traits::get(obj); }
+  void set_raw(int32_t value) override { Traits::set(obj, value); }
+};
+
+#ifdef USE_NUMBER
+/* Input widget bound to a Number entity. Home Assistant sets the value through control(), values dragged
+   on the screen are published at most every LVGL_DRAG_PUBLISH_MS, and always once on release. */
+template <class Traits>
+class LvglNumberWidget : public LvglValueWidget<Traits>, public Number
+{
+public:
+  LvglNumberWidget(lv_coord_t x, lv_coord_t y, lv_coord_t w, lv_coord_t h) : LvglValueWidget<Traits>(x, y, w, h)
+  {
+    set_range(0, 100);
+  }
+
+  void set_range(float min, float max, float step = 1.0f)
+  {
+    LvglValueBase::set_range(min, max, step);
+    this->traits.set_min_value(min);
+    this->traits.set_max_value(max);
+    this->traits.set_step(step);
+  }
+
+  void adopt(lv_obj_t *new_obj) override
+  {
+    LvglValueBase::adopt(new_obj);
+    // Only the events it handles, LV_EVENT_ALL would call it for every draw and style event too
+    lv_obj_add_event_cb(new_obj, lvgl_event_cb, LV_EVENT_VALUE_CHANGED, (void *)this);
+    lv_obj_add_event_cb(new_obj, lvgl_event_cb, LV_EVENT_RELEASED, (void *)this);
+    lv_obj_add_event_cb(new_obj, lvgl_event_cb, LV_EVENT_PRESS_LOST, (void *)this);
+  }
+
+protected:
+  uint32_t published_ms_ = 0; /* lv_tick_get() of the last value handed to the main loop */
+  bool held_ = false; /* a drag value has not been published */
+
+  void control(float value) override
+  {
+    this->show(value);
+    this->publish_state(this->from_raw(this->to_raw(value))); // as shown, rounded to the step and clamped
+  }
+
+  static void lvgl_event_cb(lv_event_t *event)
+  {
+    LvglNumberWidget *self = (LvglNumberWidget *)lv_event_get_user_data(event);
+    lv_event_code_t code = lv_event_get_code(event);
+    if (code == LV_EVENT_VALUE_CHANGED)
+    {
+      self->desired_ = self->get_raw(); // input already shows it, values still coalescing are outdated
+      if (lv_obj_has_state(self->obj, LV_STATE_PRESSED) && lv_tick_elaps(self->published_ms_) < LVGL_DRAG_PUBLISH_MS)
+      {
+        self->held_ = true;
+        value_stats.drag_held++;
+        return;
+      }
+      self->report();
+    }
+    else if (code == LV_EVENT_RELEASED || code == LV_EVENT_PRESS_LOST)
+    {
+      if (self->held_)
+        self->report(); // the value the finger left it at
+      // A value that came while pressed and was not overridden by the finger moving after it
+      else if (self->desired_ != self->get_raw())
+        self->schedule(LvglValueBase::due_values());
+    }
+  }
+
+  void report()
+  {
+    this->held_ = false;
+    this->published_ms_ = lv_tick_get();
+    value_stats.drag_sent++;
+    lvgl_report(publish_cb, this, this->get_raw());
+  }
+
+  static void publish_cb(void *widget, int32_t value)
+  {
+    LvglNumberWidget *self = (LvglNumberWidget *)widget;
+    self->publish_state(self->from_raw(value));
+  }
+};
+#endif
+
+#ifdef USE_SENSOR
+/* Display widget following a sensor */
+template <class Traits>
+class LvglSensorWidget : public LvglValueWidget<Traits>
+{
+public:
+  LvglSensorWidget(lv_coord_t x, lv_coord_t y, lv_coord_t w, lv_coord_t h, Sensor *sensor)
+      : LvglValueWidget<Traits>(x, y, w, h), sensor_(sensor)
+  {
+  }
+
+  void setup() override
+  {
+    LvglValueBase::setup();
+    this->show(this->sensor_->state); // NAN until the sensor has a state
+    this->sensor_->add_on_state_callback([this](float value) { this->show(value); });
+  }
+
+protected:
+  Sensor *sensor_;
+};
+#endif
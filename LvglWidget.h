@@ -0,0 +1,302 @@
+#pragma once
+
+#include <vector>
+#include "esphome.h"
+#include "lvgl.h"
+#include "LvglComponent.h"
+
+#ifndef LVGL_LAYOUT_MAX_ENTITIES
+#define LVGL_LAYOUT_MAX_ENTITIES 32 /* widgets that can be bound to a flash layout, see LvglLayout.h */
+#endif
+
+/* Widget commands, see LvglWidgetBase::apply_desired. Cumulative since boot. */
+struct reconcile_stats_t
+{
+  uint32_t requests;  /* states asked for by write_state */
+  uint32_t coalesced; /* requests replaced by a later one before the next frame */
+  uint32_t applied;   /* objects changed, each one an invalidation */
+  uint32_t unchanged; /* due objects already showing the desired state, invalidations avoided */
+};
+static reconcile_stats_t reconcile_stats;
+
+/* Shared part of all widget families: the lvgl object or its geometry, the page it is on, and the
+   desired state that commands set and a paused lvgl timer of the family applies to the object. */
+class LvglObjectBase : public Component
+{
+public:
+  // Until setup() the union holds the geometry, afterwards only the lvgl object is kept.
+  // A widget on a page gets its geometry back while the page is not built.
+  union
+  {
+    struct
+    {
+      lv_coord_t x;
+      lv_coord_t y;
+      lv_coord_t w;
+      lv_coord_t h;
+    } geometry;
+    lv_obj_t *obj;
+  };
+
+  lv_obj_t *get_lv_obj() { return this->created_ ? this->obj : NULL; }
+
+  // Put the widget on a page of LvglPageManager, its object only exists while that page is built.
+  // Page 0 is the screen widgets are created on by default. Set before setup.
+  void set_page(uint8_t page)
+  {
+    if (this->page_ == 0 && page != 0)
+      paged_widgets().push_back(this);
+    this->page_ = page;
+  }
+  uint8_t get_page() { return this->page_; }
+
+  // Widgets with a page other than 0, built and released by LvglPageManager
+  static std::vector<LvglObjectBase *> &paged_widgets()
+  {
+    static std::vector<LvglObjectBase *> widgets;
+    return widgets;
+  }
+
+  // Create the object on the screen of a page being built
+  void build(lv_obj_t *parent)
+  {
+    attach(create_obj(parent));
+  }
+
+  // The page is about to be deleted with the object, keep its geometry for the next build
+  void release()
+  {
+    if (!this->created_)
+      return;
+    lv_obj_t *old = obj;
+    geometry.x = lv_obj_get_x(old);
+    geometry.y = lv_obj_get_y(old);
+    geometry.w = lv_obj_get_width(old);
+    geometry.h = lv_obj_get_height(old);
+    this->created_ = false;
+  }
+
+  // Take over an object that was created and positioned elsewhere
+  virtual void adopt(lv_obj_t *new_obj)
+  {
+    obj = new_obj;
+    this->created_ = true;
+  }
+
+  // Set up after LvglComponent and the layout loader have initialized lvgl
+  float get_setup_priority() const override { return esphome::setup_priority::DATA - 1.0f; }
+
+protected:
+  /* Widgets of one family waiting for the family's timer to apply their desired state */
+  struct DueList
+  {
+    uint32_t period;  /* [ms] between two passes of the timer, 0 = with the next lv_timer_handler pass */
+    void (*report)(); /* logs the statistics of the family with the load report */
+    std::vector<LvglObjectBase *> widgets;
+    lv_timer_t *timer;
+  };
+
+  bool created_ = false;
+  bool dirty_ = false;  /* waiting in a DueList */
+  uint8_t page_ = 0;
+  int32_t desired_ = 0; /* last state asked for, by a command or input, owned by the lvgl thread */
+
+  LvglObjectBase(lv_coord_t x, lv_coord_t y, lv_coord_t w, lv_coord_t h)
+  {
+    geometry.x = x;
+    geometry.y = y;
+    geometry.w = w;
+    geometry.h = h;
+  }
+
+  virtual lv_obj_t *create_obj(lv_obj_t *parent) = 0;
+  /* Bring the object to desired_, called by the timer of the family */
+  virtual void apply_desired() = 0;
+
+  // Position a freshly created object and take it over from the geometry
+  void attach(lv_obj_t *new_obj)
+  {
+    lv_obj_set_pos(new_obj, geometry.x, geometry.y);
+    lv_obj_set_size(new_obj, geometry.w, geometry.h);
+    adopt(new_obj);
+  }
+
+  /* Have the timer of the family apply desired_, from the lvgl thread. Nothing to do when the widget
+     is due already or has no object, a page being built applies desired_ in adopt(). */
+  void schedule(DueList &due)
+  {
+    if (this->dirty_ || !this->created_)
+      return;
+    this->dirty_ = true;
+    due.widgets.push_back(this);
+    // Paused while nothing is due, so it does not shorten lv_timer_handler's sleep
+    if (due.timer == NULL)
+    {
+      due.timer = lv_timer_create(apply_due, due.period, &due);
+      if (due.report != NULL)
+        lvgl_stats_reports.push_back(due.report);
+    }
+    lv_timer_resume(due.timer);
+  }
+
+  static void apply_due(lv_timer_t *timer)
+  {
+    DueList *due = (DueList *)timer->user_data;
+    lv_timer_pause(timer);
+    for (LvglObjectBase *widget : due->widgets)
+    {
+      widget->dirty_ = false;
+      if (widget->created_) // else its page was deleted in the meantime
+        widget->apply_desired();
+    }
+    due->widgets.clear();
+  }
+};
+
+/* Shared part of the switch-like widgets. It is not a template, so the event
+   callback and write_state exist once in flash however many widget types there are. */
+class LvglWidgetBase : public LvglObjectBase, public Switch
+{
+public:
+  // Style id added on top of the widget type's own styling, see LvglStyles.h. Set before setup.
+  void set_style(uint8_t style) { this->style_ = style; }
+
+#ifdef LVGL_SNAPSHOT
+  // Draw the widget from a snapshot while it does not change, see LvglSnapshot.h. Set before setup.
+  void set_snapshot(bool snapshot) { this->snapshot_ = snapshot; }
+#endif
+
+  // Widgets constructed with a layout entity id, their lvgl object is created by LvglLayoutLoader
+  static LvglWidgetBase **layout_entities()
+  {
+    static LvglWidgetBase *entities[LVGL_LAYOUT_MAX_ENTITIES];
+    return entities;
+  }
+  // Widgets constructed with a layout id of LVGL_LAYOUT_MAX_ENTITIES or more, reported by LvglLayoutLoader
+  static std::vector<LvglWidgetBase *> &layout_rejected()
+  {
+    static std::vector<LvglWidgetBase *> widgets;
+    return widgets;
+  }
+  uint8_t get_layout_id() { return this->layout_id_; }
+
+  void adopt(lv_obj_t *new_obj) override
+  {
+    LvglObjectBase::adopt(new_obj);
+    lvgl_styles.apply(obj, this->style_);
+
+    if (this->desired_)
+      lv_obj_add_state(obj, LV_STATE_CHECKED);
+
+    // Set Callback
+    lv_obj_add_event_cb(obj, lvgl_event_cb, LV_EVENT_VALUE_CHANGED, (void *)this);
+#ifdef LVGL_SNAPSHOT
+    if (this->snapshot_)
+      new LvglSnapshot(obj); // deletes itself with the object
+#endif
+  }
+
+  void write_state(bool state) override
+  {
+    // This will be called every time the user requests a state change.
+    // Queued for the render task when lvgl runs in its own, by then a page may have been deleted
+    lvgl_call(set_desired, this, state);
+
+    // Acknowledge new state by publishing it with the next frame
+    state_publisher.queue(this, state);
+  }
+
+  static void lvgl_event_cb(lv_event_t *event)
+  {
+    lv_obj_t *target = lv_event_get_target(event);
+    LvglWidgetBase *sw = (LvglWidgetBase *)event->user_data;
+
+    bool state = (lv_obj_get_state(target) & LV_STATE_CHECKED);
+    sw->desired_ = state; // input already applied it, a command still waiting for the next frame is outdated
+
+    // Publish the new state once lv_timer_handler is done
+    lvgl_report_state(sw, state);
+  }
+
+  /* Record the state a command asks for, the object is only touched by apply_desired() */
+  static void set_desired(void *widget, int32_t state)
+  {
+    LvglWidgetBase *sw = (LvglWidgetBase *)widget;
+    reconcile_stats.requests++;
+    if (sw->dirty_)
+      reconcile_stats.coalesced++;
+    sw->desired_ = state;
+    sw->schedule(due_states());
+  }
+
+protected:
+  uint8_t style_ = STYLE_NONE;
+  uint8_t layout_id_ = 0xFF; /* LAYOUT_NO_ENTITY without a layout */
+#ifdef LVGL_SNAPSHOT
+  bool snapshot_ = false;
+#endif
+
+  LvglWidgetBase(lv_coord_t x, lv_coord_t y, lv_coord_t w, lv_coord_t h) : LvglObjectBase(x, y, w, h) {}
+
+  LvglWidgetBase(uint8_t layout_id) : LvglObjectBase(0, 0, 0, 0) // only used if the layout has no item for this id
+  {
+    this->layout_id_ = layout_id;
+    if (layout_id < LVGL_LAYOUT_MAX_ENTITIES)
+      layout_entities()[layout_id] = this;
+    else
+      layout_rejected().push_back(this); // too early to log, the logger may not be set up yet
+  }
+
+  /* Apply the desired state if it differs from what the object shows, once per lv_timer_handler pass.
+     Commands that end on the state already shown, e.g. every entity sent again after Home Assistant
+     reconnects or the echo of a change made on the screen, cause no redraw. */
+  void apply_desired() override
+  {
+    if (lv_obj_has_state(obj, LV_STATE_CHECKED) == (this->desired_ != 0))
+    {
+      reconcile_stats.unchanged++;
+      return;
+    }
+    reconcile_stats.applied++;
+    (this->desired_) ? lv_obj_add_state(obj, LV_STATE_CHECKED) : lv_obj_clear_state(obj, LV_STATE_CHECKED);
+#ifdef LVGL_SNAPSHOT
+    LvglSnapshot::changed(obj); // lvgl only redraws for the checked state, it does not report it
+#endif
+  }
+
+  static DueList &due_states()
+  {
+    static DueList due = {0, report_stats};
+    return due;
+  }
+
+  static void report_stats()
+  {
+    ESP_LOGD("lvgl", "state commands: %u requested, %u coalesced, %u applied, %u unchanged",
+             (unsigned)reconcile_stats.requests, (unsigned)reconcile_stats.coalesced,
+             (unsigned)reconcile_stats.applied, (unsigned)reconcile_stats.unchanged);
+  }
+};
+
+/* A widget type is a traits struct with one function:
+     static lv_obj_t *create(lv_obj_t *parent, LvglWidgetBase *widget);
+   which creates and styles the lvgl object, see LvglSwitch.h */
+template <class Traits>
+class LvglWidget : public LvglWidgetBase
+{
+public:
+  LvglWidget(lv_coord_t x, lv_coord_t y, lv_coord_t w, lv_coord_t h) : LvglWidgetBase(x, y, w, h) {}
+  // Bound to the item with this entity id in the flash layout
+  explicit LvglWidget(uint8_t layout_id) : LvglWidgetBase(layout_id) {}
+
+  void setup() override
+  {
+    // This will be called by App.setup(), layout widgets already have their object
+    // and widgets on other pages get theirs when the page is shown
+    if (!this->created_ && this->page_ == 0)
+      attach(create_obj(lv_scr_act()));
+  }
+
+protected:
+  lv_obj_t *create_obj(lv_obj_t *parent) override { return Traits::create(parent, this); }
+};
@@ -39,8 +39,11 @@
 #define LV_COLOR_DEPTH     16
 
  /* Swap the 2 bytes of RGB565 color.
-  * Useful if the display has a 8 bit interface (e.g. SPI)*/
+  * Useful if the display has a 8 bit interface (e.g. SPI)
+  * -D LV_COLOR_16_SWAP=1 sends the draw buffers to the TFT without swapping them on the CPU */
+#ifndef LV_COLOR_16_SWAP
 #define LV_COLOR_16_SWAP   0
+#endif
 
   /* 1: Enable screen transparency.
    * Useful for OSD or other overlapping GUIs.
@@ -76,7 +79,12 @@ typedef int16_t lv_coord_t;
   * The graphical objects and other related data are stored here. */
 
   /* 1: use custom malloc/free, 0: use the built-in `lv_mem_alloc` and `lv_mem_free` */
+  /* -D LVGL_USE_MEM_POOL selects the slab/TLSF allocator of LvglMemPool.h */
+#ifdef LVGL_USE_MEM_POOL
+#define LV_MEM_CUSTOM      1
+#else
 #define LV_MEM_CUSTOM      0
+#endif
 #if LV_MEM_CUSTOM == 0
 /* Size of the memory used by `lv_mem_alloc` in bytes (>= 2kB)*/
 
@@ -101,9 +109,16 @@ typedef int16_t lv_coord_t;
  /* Automatically defrag. on free. Defrag. means joining the adjacent free cells. */
 #  define LV_MEM_AUTO_DEFRAG  1
 #else       /*LV_MEM_CUSTOM*/
+#ifdef LVGL_USE_MEM_POOL
+#  define LV_MEM_CUSTOM_INCLUDE "lv_mem_pool.h"       /*Header for the dynamic memory function*/
+#  define LV_MEM_CUSTOM_ALLOC   lv_mem_pool_alloc     /*Wrapper to malloc*/
+#  define LV_MEM_CUSTOM_FREE    lv_mem_pool_free      /*Wrapper to free*/
+#  define LV_MEM_CUSTOM_REALLOC lv_mem_pool_realloc   /*Wrapper to realloc*/
+#else
 #  define LV_MEM_CUSTOM_INCLUDE <stdlib.h>   /*Header for the dynamic memory function*/
 #  define LV_MEM_CUSTOM_ALLOC   malloc       /*Wrapper to malloc*/
 #  define LV_MEM_CUSTOM_FREE    free         /*Wrapper to free*/
+#endif
 #endif     /*LV_MEM_CUSTOM*/
 
 /* Garbage Collector settings
@@ -275,7 +290,8 @@ typedef void* lv_indev_drv_user_data_t;            /*Type of user data in the in
  * Log settings
  *===============*/
 
-#define LV_USE_PERF_MONITOR  1
+/* The FPS/CPU overlay costs redraws, LvglPerfSensor reports the same as sensors and to the log */
+#define LV_USE_PERF_MONITOR  0
 
  /*1: Enable the log module*/
 #define LV_USE_LOG      1  // set back to 0 before release !!
@@ -414,6 +430,14 @@ typedef void* lv_indev_drv_user_data_t;            /*Type of user data in the in
 typedef void* lv_font_user_data_t;
 
 
+/* With -D LVGL_GLYPH_CACHE compressed fonts keep their decompressed glyphs, see LvglGlyphCache.h */
+#ifdef LVGL_GLYPH_CACHE
+#include "lv_glyph_cache.h"
+#define LV_FONT_CACHED(font)   lv_glyph_cache_font(font)
+#else
+#define LV_FONT_CACHED(font)   (font)
+#endif
+
 /*Always set a default font from the built-in fonts*/
 #if LV_HIGH_RESOURCE_MCU>0
 // #define LV_FONT_CUSTOM_DECLARE LV_FONT_DECLARE(lv_font_montserrat_16);
@@ -428,10 +452,10 @@ typedef void* lv_font_user_data_t;
                                LV_FONT_CUSTOM_22 \
                                LV_FONT_CUSTOM_28 \
 */
-#define LV_FONT_DEFAULT        &lv_font_montserrat_16
+#define LV_FONT_DEFAULT        LV_FONT_CACHED(&lv_font_montserrat_16)
 #else
 #define LV_FONT_CUSTOM_DECLARE LV_FONT_DECLARE(unscii_8_icon);
-#define LV_FONT_DEFAULT        &unscii_8_icon //&lv_font_unscii_8
+#define LV_FONT_DEFAULT        LV_FONT_CACHED(&unscii_8_icon) //&lv_font_unscii_8
 //#define LV_FONT_DEFAULT        my_font
 #endif
 
@@ -589,6 +613,9 @@ typedef struct {
 /*Gauge (dependencies:lv_bar, lv_linemeter)*/
 #define LV_USE_GAUGE    1
 
+/*Meter, the gauge of lvgl 8, used by LvglGauge.h*/
+#define LV_USE_METER    1
+
 /*Image (dependencies: lv_label*/
 #define LV_USE_IMG      1
 
@@ -704,6 +731,11 @@ typedef struct {
 /*Window (dependencies: lv_cont, lv_btn, lv_label, lv_img, lv_page)*/
 #define LV_USE_WIN      1
 
+/*Snapshot of an object into an image, used by LvglSnapshot.h with -D LVGL_SNAPSHOT*/
+#ifdef LVGL_SNAPSHOT
+#define LV_USE_SNAPSHOT 1
+#endif
+
 /*==================
  * Non-user section
  *==================*/
@@ -0,0 +1,23 @@
+/**
+ * @file lv_glyph_cache.h
+ * Glyph bitmap cache for compressed fonts, enabled with -D LVGL_GLYPH_CACHE, see lv_conf.h
+ * Included from the lvgl C sources, the implementation is in LvglGlyphCache.h
+ */
+
+#ifndef LV_GLYPH_CACHE_H
+#define LV_GLYPH_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct _lv_font_t;
+
+/* Font that draws like font but keeps its decompressed glyphs, font itself if it is not compressed */
+const struct _lv_font_t *lv_glyph_cache_font(const struct _lv_font_t *font);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /*LV_GLYPH_CACHE_H*/
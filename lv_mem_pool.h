@@ -0,0 +1,24 @@
+/**
+ * @file lv_mem_pool.h
+ * Allocator used by lvgl when built with -D LVGL_USE_MEM_POOL, see lv_conf.h
+ * Included from the lvgl C sources, the implementation is in LvglMemPool.h
+ */
+
+#ifndef LV_MEM_POOL_H
+#define LV_MEM_POOL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void *lv_mem_pool_alloc(size_t size);
+void lv_mem_pool_free(void *p);
+void *lv_mem_pool_realloc(void *p, size_t size);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /*LV_MEM_POOL_H*/
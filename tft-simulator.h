@@ -0,0 +1,229 @@
+#pragma once
+
+// In-memory stand-in for TFT_eSPI, selected with -D USE_TFT_SIMULATOR
+// It renders into an RGB565 framebuffer so the lvgl flush and touch paths can run on plain Linux.
+// Frames can be written to PPM files for comparison.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "lvgl.h"
+
+#ifndef TFT_ROTATION
+#define TFT_ROTATION 0
+#endif
+#ifndef TOUCH_CAL_DATA
+#define TOUCH_CAL_DATA 0, 0, 0, 0, 0
+#endif
+
+// Virtual lvgl clock, replaces the millis() tick of LV_TICK_CUSTOM_SYS_TIME_EXPR
+// Define SIM_TICK_STEP_MS to advance it by a fixed step per loop() for reproducible frames,
+// otherwise it follows the real time elapsed between loop() calls.
+static uint32_t sim_clock_ms = 0;
+
+void sim_advance(uint32_t ms)
+{
+  sim_clock_ms += ms;
+  lv_tick_inc(ms);
+}
+
+void sim_tick()
+{
+#ifdef SIM_TICK_STEP_MS
+  sim_advance(SIM_TICK_STEP_MS);
+#else
+  static auto last = std::chrono::steady_clock::now();
+  auto now = std::chrono::steady_clock::now();
+  uint32_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - last).count();
+  if (ms > 0)
+  {
+    sim_advance(ms);
+    last += std::chrono::milliseconds(ms);
+  }
+#endif
+}
+
+uint32_t sim_millis() { return sim_clock_ms; }
+
+class TFT_eSPI
+{
+public:
+  // Bus statistics since the last resetStats()
+  struct Stats
+  {
+    uint32_t transactions;
+    uint32_t windows;
+    uint32_t pushes;
+    uint32_t dma_pushes;
+    uint64_t pixels;
+  } stats;
+
+  TFT_eSPI() : fb_(TFT_WIDTH * TFT_HEIGHT, 0) { resetStats(); }
+
+  void begin() {}
+  void setRotation(uint8_t r) { rotation_ = r & 3; }
+  void setSwapBytes(bool swap) { swap_ = swap; }
+  bool getSwapBytes() { return swap_; }
+  uint16_t color565(uint8_t r, uint8_t g, uint8_t b) { return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3); }
+  void setTouch(uint16_t *calData) {}
+
+  int16_t width() { return (rotation_ & 1) ? TFT_HEIGHT : TFT_WIDTH; }
+  int16_t height() { return (rotation_ & 1) ? TFT_WIDTH : TFT_HEIGHT; }
+
+  // Transfer latency of the mock bus, e.g. 16 bits at 40 MHz is 400 ns per pixel
+  void setBusLatency(uint32_t ns_per_pixel, uint32_t us_per_transfer = 0)
+  {
+    ns_per_pixel_ = ns_per_pixel;
+    us_per_transfer_ = us_per_transfer;
+  }
+
+  void startWrite() { stats.transactions++; }
+  void endWrite() { dmaWait(); }
+
+  void setWindow(int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+  {
+    stats.windows++;
+    win_x1_ = x1;
+    win_y1_ = y1;
+    win_x2_ = x2;
+    win_y2_ = y2;
+    cur_x_ = x1;
+    cur_y_ = y1;
+  }
+  void setAddrWindow(int32_t x, int32_t y, int32_t w, int32_t h) { setWindow(x, y, x + w - 1, y + h - 1); }
+
+  void pushPixels(const void *data, uint32_t len)
+  {
+    stats.pushes++;
+    write(data, len, swap_);
+    busy_until_ = std::chrono::steady_clock::now() + latency(len);
+    dmaWait();
+  }
+
+  // Returns immediately, dmaBusy() stays true for the configured transfer latency.
+  // Like TFT_eSPI it byte swaps the buffer in place first when swapping is on.
+  void pushPixelsDMA(uint16_t *data, uint32_t len)
+  {
+    dmaWait();
+    stats.dma_pushes++;
+    if (swap_)
+      for (uint32_t i = 0; i < len; i++)
+        data[i] = (uint16_t)((data[i] << 8) | (data[i] >> 8));
+    write(data, len, false);
+    busy_until_ = std::chrono::steady_clock::now() + latency(len);
+  }
+
+  void pushBlock(uint16_t color, uint32_t len)
+  {
+    stats.pushes++;
+    stats.pixels += len;
+    while (len--)
+      plot(color);
+  }
+
+  bool initDMA(bool ctrl_cs = false) { return true; }
+  void deInitDMA() {}
+  bool dmaBusy() { return std::chrono::steady_clock::now() < busy_until_; }
+  void dmaWait() { std::this_thread::sleep_until(busy_until_); }
+
+  void fillScreen(uint32_t color) { fillRect(0, 0, width(), height(), color); }
+  void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color)
+  {
+    setAddrWindow(x, y, w, h);
+    pushBlock(color, w * h);
+  }
+  void drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color) { fillRect(x, y, w, 1, color); }
+
+  void drawXBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color)
+  {
+    int32_t stride = (w + 7) / 8;
+    for (int16_t j = 0; j < h; j++)
+      for (int16_t i = 0; i < w; i++)
+        if (bitmap[j * stride + i / 8] & (1 << (i & 7)))
+          fillRect(x + i, y + j, 1, 1, color);
+  }
+
+  // Touch injection for tests, the point is in screen coordinates
+  void setTouchPoint(uint16_t x, uint16_t y)
+  {
+    touch_x_ = x;
+    touch_y_ = y;
+    touched_ = true;
+  }
+  void releaseTouch() { touched_ = false; }
+
+  bool getTouch(uint16_t *x, uint16_t *y, uint16_t threshold = 600)
+  {
+    if (!touched_)
+      return false;
+    *x = touch_x_;
+    *y = touch_y_;
+    return true;
+  }
+
+  void resetStats() { memset(&stats, 0, sizeof(stats)); }
+
+  // Pixel in panel colour order, whatever the byte swapping of the source was
+  uint16_t readPixel(int32_t x, int32_t y) { return fb_[y * width() + x]; }
+  const uint16_t *framebuffer() { return fb_.data(); }
+
+  bool writePPM(const char *path)
+  {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+      return false;
+
+    fprintf(f, "P6\n%d %d\n255\n", width(), height());
+    for (uint16_t c : fb_)
+    {
+      uint8_t rgb[3] = {(uint8_t)((c >> 8) & 0xF8), (uint8_t)((c >> 3) & 0xFC), (uint8_t)(c << 3)};
+      fwrite(rgb, 1, sizeof(rgb), f);
+    }
+    fclose(f);
+    return true;
+  }
+
+private:
+  std::vector<uint16_t> fb_;
+  uint8_t rotation_ = 0;
+  bool swap_ = false;
+  int32_t win_x1_ = 0, win_y1_ = 0, win_x2_ = 0, win_y2_ = 0;
+  int32_t cur_x_ = 0, cur_y_ = 0;
+  uint32_t ns_per_pixel_ = 0;
+  uint32_t us_per_transfer_ = 0;
+  std::chrono::steady_clock::time_point busy_until_;
+  uint16_t touch_x_ = 0, touch_y_ = 0;
+  bool touched_ = false;
+
+  std::chrono::nanoseconds latency(uint32_t len)
+  {
+    return std::chrono::nanoseconds((uint64_t)len * ns_per_pixel_ + (uint64_t)us_per_transfer_ * 1000);
+  }
+
+  // The panel receives the high byte first, without swapping that is the first byte in memory
+  void write(const void *data, uint32_t len, bool swap)
+  {
+    const uint16_t *p = (const uint16_t *)data;
+    stats.pixels += len;
+    while (len--)
+    {
+      uint16_t c = *p++;
+      plot(swap ? c : (uint16_t)((c << 8) | (c >> 8)));
+    }
+  }
+
+  void plot(uint16_t color)
+  {
+    if (cur_x_ >= 0 && cur_x_ < width() && cur_y_ >= 0 && cur_y_ < height())
+      fb_[cur_y_ * width() + cur_x_] = color;
+
+    if (++cur_x_ > win_x2_)
+    {
+      cur_x_ = win_x1_;
+      if (++cur_y_ > win_y2_)
+        cur_y_ = win_y1_;
+    }
+  }
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+// Boot splash blitter, include after lvgl.h, TFT_eSPI.h (or tft-simulator.h) and bootlogo.h
+// The background is filled around the logo instead of under it, the logo itself is sent as one
+// window of RGB565 rows that are built from horizontal runs, with DMA when USE_DMA_TO_TFT is set.
+
+#include <algorithm>
+
+/* The one place the TFT is started, for the splash and for lvgl alike: both must agree on DMA and on
+   the byte order pushPixels expects. With LV_COLOR_16_SWAP lvgl renders in panel byte order already. */
+static void tft_init(TFT_eSPI &tft)
+{
+  tft.begin();
+#ifdef USE_DMA_TO_TFT
+  tft.initDMA();
+#endif
+  tft.setSwapBytes(!LV_COLOR_16_SWAP);
+  tft.setRotation(TFT_ROTATION);
+}
+
+/* Run-length encoded splash image, an alternative to the 1-bpp XBM for larger or multi-colour logos.
+   data holds (run length - 1, palette index) byte pairs, runs continue on the next row.
+   Define logoRle in bootlogo.h as the name of a splash_rle_t to use it instead of logoImage. */
+struct splash_rle_t
+{
+  uint16_t width;
+  uint16_t height;
+  uint16_t colors;         /* palette entries, at most 256 */
+  const uint16_t *palette; /* RGB565 */
+  const uint8_t *data;
+};
+
+/* Hands out rows in one half of the scratch buffer while the other half is being sent */
+class SplashWriter
+{
+public:
+  SplashWriter(TFT_eSPI &tft, uint16_t *scratch, uint32_t scratch_px) : tft_(tft)
+  {
+    this->scratch_ = scratch;
+#ifdef USE_DMA_TO_TFT
+    this->half_ = scratch_px / 2;
+#else
+    this->half_ = scratch_px;
+#endif
+    this->cur_ = scratch;
+  }
+
+  uint16_t *row(uint32_t w)
+  {
+    if (this->used_ + w > this->half_)
+      flush();
+    return this->cur_ + this->used_;
+  }
+  void commit(uint32_t w) { this->used_ += w; }
+
+  void flush()
+  {
+    if (this->used_ == 0)
+      return;
+#ifdef USE_DMA_TO_TFT
+    this->tft_.pushPixelsDMA(this->cur_, this->used_); /* waits for the previous half */
+    this->cur_ = (this->cur_ == this->scratch_) ? this->scratch_ + this->half_ : this->scratch_;
+#else
+    this->tft_.pushPixels(this->cur_, this->used_);
+#endif
+    this->used_ = 0;
+  }
+
+private:
+  TFT_eSPI &tft_;
+  uint16_t *scratch_;
+  uint16_t *cur_;
+  uint32_t half_;
+  uint32_t used_ = 0;
+};
+
+/* Colour as pushPixels expects it, which depends on the byte swapping of TFT_eSPI */
+static inline uint16_t splash_pixel(TFT_eSPI &tft, uint16_t color)
+{
+  return tft.getSwapBytes() ? color : (uint16_t)((color << 8) | (color >> 8));
+}
+
+/* Fill the screen except the w x h rectangle at x,y */
+static void splash_fill_around(TFT_eSPI &tft, int32_t x, int32_t y, int32_t w, int32_t h, uint16_t bg)
+{
+  int32_t sw = tft.width();
+  int32_t sh = tft.height();
+  tft.fillRect(0, 0, sw, y, bg);
+  tft.fillRect(0, y + h, sw, sh - y - h, bg);
+  tft.fillRect(0, y, x, h, bg);
+  tft.fillRect(x + w, y, sw - x - w, h, bg);
+}
+
+static void splash_blit_xbm(SplashWriter &out, const uint8_t *xbm, int32_t w, int32_t h, uint16_t fg, uint16_t bg)
+{
+  int32_t stride = (w + 7) / 8;
+  for (int32_t j = 0; j < h; j++)
+  {
+    const uint8_t *bits = xbm + j * stride;
+    uint16_t *line = out.row(w);
+
+    int32_t i = 0;
+    while (i < w)
+    {
+      bool on = bits[i >> 3] & (1 << (i & 7));
+      uint8_t same = on ? 0xFF : 0x00;
+      int32_t end = i + 1;
+      while (end < w)
+      {
+        if ((end & 7) == 0 && end + 8 <= w && bits[end >> 3] == same)
+          end += 8; /* whole byte in the run */
+        else if (((bits[end >> 3] >> (end & 7)) & 1) == on)
+          end++;
+        else
+          break;
+      }
+      std::fill(line + i, line + end, on ? fg : bg);
+      i = end;
+    }
+    out.commit(w);
+  }
+}
+
+static void splash_blit_rle(SplashWriter &out, const splash_rle_t &img, uint16_t *palette)
+{
+  const uint8_t *p = img.data;
+  uint32_t run = 0;
+  uint16_t color = 0;
+  for (uint16_t j = 0; j < img.height; j++)
+  {
+    uint16_t *line = out.row(img.width);
+    uint16_t i = 0;
+    while (i < img.width)
+    {
+      if (run == 0)
+      {
+        run = p[0] + 1;
+        color = palette[p[1]];
+        p += 2;
+      }
+      uint32_t n = std::min<uint32_t>(run, img.width - i);
+      std::fill(line + i, line + i + n, color);
+      i += n;
+      run -= n;
+    }
+    out.commit(img.width);
+  }
+}
+
+/* Draw the bootlogo.h logo centered on the screen, the scratch buffer holds at least two logo rows */
+static void tft_splash(TFT_eSPI &tft, uint16_t fg, uint16_t bg, uint16_t *scratch, uint32_t scratch_px)
+{
+#ifdef logoRle
+  int32_t w = logoRle.width;
+  int32_t h = logoRle.height;
+#else
+  int32_t w = logoWidth;
+  int32_t h = logoHeight;
+#endif
+  int32_t x = (tft.width() - w) / 2;
+  int32_t y = (tft.height() - h) / 2;
+
+  splash_fill_around(tft, x, y, w, h, bg);
+
+  tft.startWrite();
+  tft.setWindow(x, y, x + w - 1, y + h - 1);
+  SplashWriter out(tft, scratch, scratch_px);
+#ifdef logoRle
+  uint16_t palette[256];
+  for (uint16_t i = 0; i < logoRle.colors && i < 256; i++)
+    palette[i] = splash_pixel(tft, logoRle.palette[i]);
+  splash_blit_rle(out, logoRle, palette);
+#else
+  splash_blit_xbm(out, logoImage, w, h, splash_pixel(tft, fg), splash_pixel(tft, bg));
+#endif
+  out.flush();
+  tft.endWrite();
+}
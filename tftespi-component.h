@@ -1,8 +1,9 @@
 #pragma once
 #include "esphome.h"
+#include "lvgl.h" // for LV_COLOR_16_SWAP
 #include "tft_espi.h"
 #include "bootlogo.h"
-#include "lvgl.h" // for lv_color_make
+#include "tft-splash.h"
 
 TFT_eSPI tft;
 
@@ -13,9 +14,7 @@ public:
   {
     // This will be called once to set up the component
     // think of it as the setup() call in Arduino
-    tft.begin();
-    tft.setSwapBytes(true); /* set endianess */
-    tft.setRotation(TFT_ROTATION);
+    tft_init(tft);
     splashscreen();
     uint16_t calData[5] = {TOUCH_CAL_DATA};
     tft.setTouch(calData);
@@ -34,12 +33,11 @@ private:
   {
     uint8_t fg[] = logoFgColor;
     uint8_t bg[] = logoBgColor;
-    lv_color_t fgColor = lv_color_make(fg[0], fg[1], fg[2]);
-    lv_color_t bgColor = lv_color_make(bg[0], bg[1], bg[2]);
+    // Plain RGB565 as in LvglComponent, tft_splash converts it for pushPixels
+    uint16_t fgColor = tft.color565(fg[0], fg[1], fg[2]);
+    uint16_t bgColor = tft.color565(bg[0], bg[1], bg[2]);
 
-    tft.fillScreen(bgColor.full);
-    int x = (tft.width() - logoWidth) / 2;
-    int y = (tft.height() - logoHeight) / 2;
-    tft.drawXBitmap(x, y, logoImage, logoWidth, logoHeight, fgColor.full);
+    static uint16_t rows[4 * TFT_HEIGHT]; // two rows per DMA half, also for a rotated screen
+    tft_splash(tft, fgColor, bgColor, rows, sizeof(rows) / sizeof(rows[0]));
   }
 };
\ No newline at end of file